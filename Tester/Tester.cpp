@@ -1,15 +1,102 @@
 #include "stdafx.h"
 #include "CppUnitTest.h"
 #include <concurrent_sorted_list.h>
+#include <range_partitioned_sorted_list.h>
+#include <merged_view.h>
+#include <tournament_queue.h>
+#include <bitmap_priority_queue.h>
+#include <concurrent_calendar_queue.h>
+#include <chunked_priority_queue.h>
 #include <gdul\concurrent_queue.h>
 #include <thread>
 #include <random>
+#include <string>
 #include <heap.h>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
 namespace Tester
 {
+template <class T>
+class counting_allocator
+{
+public:
+	typedef T value_type;
+
+	counting_allocator(std::atomic<int>* liveAllocations) : myLiveAllocations(liveAllocations) {}
+	template <class U>
+	counting_allocator(const counting_allocator<U>& other) : myLiveAllocations(other.myLiveAllocations) {}
+
+	T* allocate(std::size_t n) {
+		++(*myLiveAllocations);
+		return std::allocator<T>().allocate(n);
+	}
+	void deallocate(T* ptr, std::size_t n) {
+		--(*myLiveAllocations);
+		std::allocator<T>().deallocate(ptr, n);
+	}
+
+	std::atomic<int>* myLiveAllocations;
+};
+
+struct publish_traits : gdul::csl_default_traits
+{
+	static constexpr bool Publish_Top_Key = true;
+};
+struct prefetch_traits : gdul::csl_default_traits
+{
+	static constexpr std::size_t Prefetch_Distance = 2;
+};
+struct jump_index_traits : gdul::csl_default_traits
+{
+	static constexpr std::size_t Jump_Index_Stride = 8;
+	typedef gdul::csl_atomic_stats<> stats_policy;
+};
+struct adaptive_traits : gdul::csl_default_traits
+{
+	static constexpr std::size_t Jump_Index_Stride = 4;
+	static constexpr std::size_t Jump_Index_Rebuild_Step = 16;
+	static constexpr std::size_t Jump_Index_Min_Size = 64;
+	typedef gdul::csl_atomic_stats<> stats_policy;
+};
+// Advances only when told to
+struct manual_clock
+{
+	typedef std::chrono::milliseconds duration;
+	typedef duration::rep rep;
+	typedef duration::period period;
+	typedef std::chrono::time_point<manual_clock> time_point;
+	static constexpr bool is_steady = true;
+
+	static time_point now() { return time_point(duration(ourNow.load())); }
+
+	static std::atomic<rep> ourNow;
+};
+std::atomic<manual_clock::rep> manual_clock::ourNow(0);
+
+struct expiry_traits : gdul::csl_default_traits
+{
+	typedef gdul::csl_clock_expiry<manual_clock> expiry_policy;
+};
+struct top_k_traits : gdul::csl_default_traits
+{
+	static constexpr std::size_t Capacity = 100;
+	static constexpr std::size_t Jump_Index_Stride = 16;
+};
+struct order_statistics_traits : gdul::csl_default_traits
+{
+	static constexpr std::size_t Jump_Index_Stride = 16;
+	static constexpr bool Jump_Index_Counts = true;
+};
+struct quantile_traits : gdul::csl_default_traits
+{
+	typedef gdul::csl_quantile_sketch<32, 4> quantile_policy;
+};
+struct pop_batch_traits : gdul::csl_default_traits
+{
+	static constexpr std::size_t Pop_Batch_Threshold = 8;
+};
+
 TEST_CLASS(UnitTest1)
 {
 public:
@@ -263,5 +350,1319 @@ public:
 		Assert::IsTrue(list.size() == 0, L"Bad size");
 
 	}
+	TEST_METHOD(traits_reject_duplicates) {
+		struct unique_traits : gdul::csl_default_traits
+		{
+			typedef gdul::csl_reject_duplicates duplicate_policy;
+			typedef gdul::csl_exponential_backoff<> backoff_policy;
+			typedef gdul::csl_atomic_stats<> stats_policy;
+		};
+		gdul::concurrent_sorted_list<uint64_t, int, gdul::csldetail::tiny_less, unique_traits> list;
+
+		Assert::IsTrue(list.insert({ 1, 1 }), L"Failed to insert unique key");
+		Assert::IsTrue(list.insert({ 2, 2 }), L"Failed to insert unique key");
+		Assert::IsFalse(list.insert({ 1, 3 }), L"Duplicate key was accepted");
+		Assert::IsTrue(list.size() == 2, L"Bad size");
+
+		std::pair<uint64_t, int> out;
+		Assert::IsTrue(list.try_pop(out) && out.second == 1, L"Duplicate replaced original entry");
+		Assert::IsTrue(list.insert({ 1, 3 }), L"Key should be insertable again after pop");
+
+		Assert::IsTrue(list.get_stats().inserts() == 3, L"Bad insert count");
+		Assert::IsTrue(list.get_stats().pops() == 1, L"Bad pop count");
+	}
+	TEST_METHOD(user_allocator) {
+		struct allocator_traits : gdul::csl_default_traits
+		{
+			typedef counting_allocator<int> allocator_type;
+		};
+		typedef gdul::concurrent_sorted_list<uint64_t, int, gdul::csldetail::tiny_less, allocator_traits> list_type;
+
+		std::atomic<int> liveAllocations(0);
+		{
+			const list_type::allocator_type allocator(&liveAllocations);
+			list_type list(allocator);
+
+			for (int i = 0; i < 16; ++i) {
+				list.insert({ static_cast<uint64_t>(16 - i), i });
+			}
+			Assert::IsTrue(liveAllocations == 16, L"Nodes were not allocated through the user allocator");
+
+			std::pair<uint64_t, int> out;
+			Assert::IsTrue(list.try_pop(out) && out.first == 1, L"Bad pop order");
+		}
+		Assert::IsTrue(liveAllocations == 0, L"Nodes were not returned to the user allocator");
+	}
+#ifdef CSL_PMR_SUPPORT
+	TEST_METHOD(pmr_allocator) {
+		uint8_t buffer[4096];
+		std::pmr::monotonic_buffer_resource resource(buffer, sizeof(buffer));
+
+		gdul::concurrent_sorted_list<uint64_t, int, gdul::csldetail::tiny_less, gdul::csl_pmr_traits> list(&resource);
+
+		list.insert({ 2, 2 });
+		list.insert({ 1, 1 });
+
+		std::pair<uint64_t, int> out;
+		Assert::IsTrue(list.try_pop(out) && out.second == 1, L"Bad pop order");
+	}
+#endif
+	TEST_METHOD(shared_pool) {
+		typedef gdul::concurrent_sorted_list<uint64_t, int> list_type;
+
+		list_type::pool_type pool(8);
+		const std::size_t initial(pool.avaliable());
+		{
+			list_type first(pool);
+			list_type second(pool);
+
+			Assert::IsTrue(pool.avaliable() == initial, L"Constructing an empty list should not allocate");
+
+			first.insert({ 1, 1 });
+			second.insert({ 2, 2 });
+
+			Assert::IsTrue(pool.avaliable() == initial - 2, L"Nodes were not drawn from the shared pool");
+
+			std::pair<uint64_t, int> out;
+			Assert::IsTrue(first.try_pop(out) && out.second == 1, L"Bad value");
+			Assert::IsTrue(second.try_pop(out) && out.second == 2, L"Bad value");
+		}
+		Assert::IsTrue(pool.avaliable() == initial, L"Nodes were not returned to the shared pool");
+	}
+	TEST_METHOD(global_pool) {
+		typedef gdul::concurrent_sorted_list<uint64_t, int, gdul::csldetail::tiny_less, gdul::csl_global_pool_traits> list_type;
+
+		std::vector<list_type> lists(64);
+
+		for (uint64_t i = 0; i < lists.size(); ++i) {
+			lists[i].insert({ i, static_cast<int>(i) });
+		}
+		for (uint64_t i = 0; i < lists.size(); ++i) {
+			std::pair<uint64_t, int> out;
+			Assert::IsTrue(lists[i].try_pop(out) && out.first == i, L"Bad value");
+		}
+	}
+	TEST_METHOD(value_construction) {
+		struct no_default
+		{
+			no_default(int value) : myValue(value) {}
+			int myValue;
+		};
+		gdul::concurrent_sorted_list<uint64_t, no_default> trivial;
+
+		trivial.insert({ 2, no_default(2) });
+		trivial.insert({ 1, no_default(1) });
+
+		std::pair<uint64_t, no_default> trivialOut(0, no_default(0));
+		Assert::IsTrue(trivial.try_pop(trivialOut) && trivialOut.second.myValue == 1, L"Bad trivially copyable value");
+
+		gdul::concurrent_sorted_list<uint64_t, std::string> nonTrivial;
+
+		nonTrivial.insert({ 2, std::string(64, 'b') });
+		nonTrivial.insert({ 1, std::string(64, 'a') });
+
+		std::string nonTrivialOut;
+		Assert::IsTrue(nonTrivial.try_pop(nonTrivialOut) && nonTrivialOut == std::string(64, 'a'), L"Bad non trivially copyable value");
+	}
+	TEST_METHOD(single_consumer) {
+		gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, gdul::csl_single_consumer_traits> list;
+
+		const uint64_t producers(4);
+		const uint64_t perProducer(10000);
+
+		std::atomic<bool> begin(false);
+		std::vector<std::thread> threads;
+		for (uint64_t i = 0; i < producers; ++i) {
+			threads.emplace_back([&list, &begin, i, perProducer]() {
+				while (!begin) {
+					std::this_thread::yield();
+				}
+				for (uint64_t j = 0; j < perProducer; ++j) {
+					list.insert({ j, i });
+				}
+			});
+		}
+
+		uint64_t popped(0);
+		std::vector<uint64_t> lastKey(producers, 0);
+		std::pair<uint64_t, uint64_t> out;
+
+		begin = true;
+		while (popped < producers * perProducer) {
+			if (list.try_pop(out)) {
+				Assert::IsTrue(lastKey[out.second] <= out.first, L"Entries from one producer popped out of order");
+				lastKey[out.second] = out.first;
+				++popped;
+			}
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+
+		Assert::IsFalse(list.try_pop(out), L"Popped from empty list");
+		Assert::IsTrue(list.size() == 0, L"Bad size");
+
+		list.insert({ 2, 2 });
+		list.insert({ 1, 1 });
+		Assert::IsTrue(list.size() == 2, L"Bad size");
+
+		out.first = 2;
+		Assert::IsFalse(list.compare_try_pop(out), L"Popped mismatched key");
+		Assert::IsTrue(out.first == 1 && list.compare_try_pop(out) && out.second == 1, L"Bad compare pop");
+		Assert::IsTrue(list.size() == 1, L"Bad size");
+
+		// Erased from under the consumer
+		list.insert({ 3, 3 });
+		Assert::IsTrue(list.erase_range(0, 3) == 1, L"Bad erased count");
+		Assert::IsTrue(list.try_pop(out) && out.first == 3 && list.size() == 0, L"Bad pop after erase");
+	}
+	TEST_METHOD(unsafe_operations) {
+		gdul::concurrent_sorted_list<uint64_t, uint64_t> list;
+
+		std::default_random_engine rng(7);
+		std::uniform_int_distribution<uint64_t> dist(0, 1000);
+
+		for (uint32_t i = 0; i < 500; ++i) {
+			const uint64_t key(dist(rng));
+			list.unsafe_insert({ key, key });
+		}
+		std::vector<std::pair<uint64_t, uint64_t>> sorted;
+		for (uint64_t i = 0; i < 500; ++i) {
+			sorted.push_back({ i * 2, i * 2 });
+		}
+		sorted.push_back({ 1, 1 });
+
+		Assert::IsTrue(list.unsafe_insert_sorted(sorted.begin(), sorted.end()) == sorted.size(), L"Bad inserted count");
+		list.insert({ 3, 3 });
+		Assert::IsTrue(list.size() == 1002, L"Bad size");
+
+		std::pair<uint64_t, uint64_t> out;
+		Assert::IsTrue(list.try_pop(out) && out.first == 0, L"Bad value");
+
+		uint64_t last(0);
+		uint32_t popped(1);
+		while (list.unsafe_try_pop(out)) {
+			Assert::IsTrue(last <= out.first && out.first == out.second, L"Bad pop order");
+			last = out.first;
+			++popped;
+		}
+		Assert::IsTrue(popped == 1002 && list.size() == 0, L"Bad size");
+
+		struct unique_traits : gdul::csl_default_traits
+		{
+			typedef gdul::csl_reject_duplicates duplicate_policy;
+		};
+		gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, unique_traits> unique;
+
+		const std::pair<uint64_t, uint64_t> duplicates[]{ { 1, 1 }, { 1, 2 }, { 2, 2 }, { 2, 3 } };
+		Assert::IsTrue(unique.unsafe_insert_sorted(std::begin(duplicates), std::end(duplicates)) == 2, L"Duplicates were accepted");
+		Assert::IsFalse(unique.unsafe_insert({ 2, 4 }), L"Duplicate was accepted");
+
+		// Read through move iterators, entries are moved into the list
+		gdul::concurrent_sorted_list<uint64_t, std::string> strings;
+		std::vector<std::pair<uint64_t, std::string>> movable;
+		for (uint64_t i = 0; i < 8; ++i) {
+			movable.push_back({ i, std::string(64, 'a') + std::to_string(i) });
+		}
+		Assert::IsTrue(strings.unsafe_insert_sorted(std::make_move_iterator(movable.begin()), std::make_move_iterator(movable.end())) == 8, L"Bad inserted count");
+		for (const std::pair<uint64_t, std::string>& entry : movable) {
+			Assert::IsTrue(entry.second.empty(), L"Entry copied instead of moved");
+		}
+		std::pair<uint64_t, std::string> stringOut;
+		Assert::IsTrue(strings.try_pop(stringOut) && stringOut.second == std::string(64, 'a') + "0", L"Bad moved value");
+	}
+	TEST_METHOD(sharded_size) {
+		struct sharded_traits : gdul::csl_default_traits
+		{
+			typedef gdul::csl_sharded_size<> size_policy;
+		};
+		gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, sharded_traits> list;
+
+		const uint64_t perThread(10000);
+		std::atomic<uint64_t> popped(0);
+
+		std::vector<std::thread> threads;
+		for (uint64_t i = 0; i < 4; ++i) {
+			threads.emplace_back([&list, &popped, i, perThread]() {
+				std::pair<uint64_t, uint64_t> out;
+				for (uint64_t j = 0; j < perThread; ++j) {
+					list.insert({ j, i });
+					if (list.try_pop(out)) {
+						++popped;
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+
+		Assert::IsTrue(list.size() == list.size_exact(), L"Sharded size disagrees with list contents");
+		Assert::IsTrue(list.size() == 4 * perThread - popped, L"Bad size");
+
+		std::pair<uint64_t, uint64_t> out;
+		while (list.try_pop(out));
+		Assert::IsTrue(list.size() == 0 && list.size_exact() == 0, L"Bad size");
+		Assert::IsFalse(list.try_pop(out), L"Popped from empty list");
+	}
+	TEST_METHOD(published_top_key) {
+		gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, publish_traits> list;
+
+		uint64_t top(0);
+		Assert::IsFalse(list.try_peek_top_key(top), L"Peeked key in empty list");
+
+		list.insert({ 5, 5 });
+		list.insert({ 3, 3 });
+		list.insert({ 4, 4 });
+		Assert::IsTrue(list.try_peek_top_key(top) && top == 3, L"Bad top key after insert");
+
+		std::pair<uint64_t, uint64_t> out;
+		list.try_pop(out);
+		Assert::IsTrue(list.try_peek_top_key(top) && top == 4, L"Bad top key after pop");
+
+		std::vector<std::thread> threads;
+		for (uint64_t i = 0; i < 4; ++i) {
+			threads.emplace_back([&list, i]() {
+				std::default_random_engine rng(static_cast<unsigned>(i));
+				std::uniform_int_distribution<uint64_t> dist(0, 10000);
+				std::pair<uint64_t, uint64_t> out;
+				for (uint32_t j = 0; j < 10000; ++j) {
+					list.insert({ dist(rng), i });
+					list.try_pop(out);
+				}
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+
+		Assert::IsTrue(list.try_peek_top_key(top) && list.try_pop(out) && top == out.first, L"Published top key does not match front");
+
+		list.unsafe_insert({ 0, 0 });
+		Assert::IsTrue(list.try_peek_top_key(top) && top == 0, L"Bad top key after unsafe insert");
+
+		list.unsafe_clear();
+		Assert::IsFalse(list.try_peek_top_key(top), L"Peeked key in cleared list");
+	}
+	TEST_METHOD(prefetch) {
+		gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, prefetch_traits> list;
+
+		for (uint64_t i = 0; i < 64; ++i) {
+			list.insert({ (i * 37) % 64, i });
+		}
+		for (uint64_t i = 64; i < 128; ++i) {
+			list.unsafe_insert({ (i * 37) % 64 + 64, i });
+		}
+
+		std::pair<uint64_t, uint64_t> out;
+		for (uint64_t i = 0; i < 128; ++i) {
+			Assert::IsTrue(list.try_pop(out) && out.first == i, L"Bad pop order");
+		}
+	}
+	TEST_METHOD(jump_index) {
+		struct counting_traits : gdul::csl_default_traits
+		{
+			typedef gdul::csl_atomic_stats<> stats_policy;
+		};
+		gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, counting_traits> plain;
+		gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, jump_index_traits> indexed;
+
+		std::default_random_engine rng(3);
+		std::uniform_int_distribution<uint64_t> dist(0, 100000);
+		for (uint32_t i = 0; i < 2000; ++i) {
+			const uint64_t key(dist(rng));
+			plain.insert({ key, key });
+			indexed.insert({ key, key });
+		}
+		Assert::IsTrue(indexed.get_stats().traversed_nodes() * 4 < plain.get_stats().traversed_nodes(), L"Index did not shorten traversal");
+
+		std::vector<std::thread> threads;
+		for (uint64_t i = 0; i < 4; ++i) {
+			threads.emplace_back([&indexed, i]() {
+				std::default_random_engine rng(static_cast<unsigned>(i));
+				std::uniform_int_distribution<uint64_t> dist(0, 100000);
+				std::pair<uint64_t, uint64_t> out;
+				for (uint32_t j = 0; j < 2000; ++j) {
+					const uint64_t key(dist(rng));
+					indexed.insert({ key, key });
+					if (j % 2) {
+						indexed.try_pop(out);
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		indexed.rebuild_index();
+
+		Assert::IsTrue(indexed.size() == 6000 && indexed.size_exact() == 6000, L"Bad size");
+
+		std::pair<uint64_t, uint64_t> out;
+		uint64_t last(0);
+		while (indexed.try_pop(out)) {
+			Assert::IsTrue(last <= out.first && out.first == out.second, L"Bad pop order");
+			last = out.first;
+		}
+	}
+	TEST_METHOD(compare_try_pop_size) {
+		gdul::concurrent_sorted_list<uint64_t, uint64_t> list;
+
+		list.insert({ 1, 1 });
+
+		std::pair<uint64_t, uint64_t> out(2, 0);
+		Assert::IsFalse(list.compare_try_pop(out), L"Popped mismatched key");
+		Assert::IsTrue(list.size() == 1, L"Failed compare pop changed size");
+		Assert::IsTrue(list.compare_try_pop(out) && out.second == 1, L"Bad compare pop");
+		Assert::IsTrue(list.size() == 0, L"Bad size");
+	}
+	TEST_METHOD(adaptive_index) {
+		gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, adaptive_traits> list;
+
+		for (uint64_t i = 0; i < 32; ++i) {
+			list.insert({ i * 2, i });
+		}
+		Assert::IsFalse(list.indexed(), L"Small list was indexed");
+
+		for (uint64_t i = 32; i < 1000; ++i) {
+			list.insert({ i * 2, i });
+		}
+		Assert::IsTrue(list.indexed(), L"Large list was not indexed");
+
+		// Unindexed, these would walk some 500 nodes each
+		std::default_random_engine rng(7);
+		std::uniform_int_distribution<uint64_t> dist(0, 2000);
+		const std::size_t before(list.get_stats().traversed_nodes());
+		for (uint32_t i = 0; i < 100; ++i) {
+			const uint64_t key(dist(rng) | 1);
+			list.insert({ key, key });
+		}
+		Assert::IsTrue(list.get_stats().traversed_nodes() - before < 100 * 64, L"Index did not shorten traversal");
+
+		std::vector<std::thread> threads;
+		for (uint64_t i = 0; i < 4; ++i) {
+			threads.emplace_back([&list, i]() {
+				std::default_random_engine rng(static_cast<unsigned>(i));
+				std::uniform_int_distribution<uint64_t> dist(0, 4000);
+				std::pair<uint64_t, uint64_t> out;
+				for (uint32_t j = 0; j < 2000; ++j) {
+					const uint64_t key(dist(rng) | 1);
+					list.insert({ key, key });
+					list.try_pop(out);
+				}
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+
+		std::pair<uint64_t, uint64_t> out;
+		while (10 < list.size()) {
+			list.try_pop(out);
+		}
+		list.insert({ 0, 0 });
+		Assert::IsFalse(list.indexed(), L"Index outlived shrinking");
+
+		uint64_t last(0);
+		while (list.try_pop(out)) {
+			Assert::IsTrue(last <= out.first, L"Out of order");
+			last = out.first;
+		}
+	}
+	TEST_METHOD(merge_split) {
+		typedef gdul::concurrent_sorted_list<uint64_t, std::string> list_type;
+
+		list_type evens;
+		list_type odds;
+		for (uint64_t i = 0; i < 1000; ++i) {
+			(i % 2 ? odds : evens).insert({ i, std::to_string(i) });
+		}
+
+		// Separately owned pools, so entries are copied
+		Assert::IsTrue(evens.merge(std::move(odds)) == 500, L"Bad merge count");
+		Assert::IsTrue(evens.size() == 1000 && odds.size() == 0, L"Bad size after merge");
+
+		list_type upper;
+		Assert::IsTrue(evens.split_at(600, upper) == 400, L"Bad split count");
+		Assert::IsTrue(evens.size() == 600 && upper.size() == 400, L"Bad size after split");
+
+		std::pair<uint64_t, std::string> out;
+		Assert::IsTrue(upper.try_pop(out) && out.first == 600 && out.second == "600", L"Bad split front");
+
+		// Sharing a pool since the split, so nodes are moved back
+		Assert::IsTrue(evens.merge(std::move(upper)) == 399, L"Bad merge back count");
+
+		for (uint64_t i = 0; i < 1000; ++i) {
+			if (i == 600) {
+				continue;
+			}
+			Assert::IsTrue(evens.try_pop(out) && out.first == i && out.second == std::to_string(i), L"Bad merged order");
+		}
+		Assert::IsFalse(evens.try_pop(out), L"Merged list not drained");
+
+		// Splits racing pops on the source
+		gdul::concurrent_sorted_list<uint64_t, uint64_t> source;
+		for (uint64_t i = 0; i < 10000; ++i) {
+			source.insert({ i, i });
+		}
+
+		std::atomic<uint64_t> popped(0);
+		std::vector<std::thread> threads;
+		for (uint32_t i = 0; i < 4; ++i) {
+			threads.emplace_back([&source, &popped]() {
+				std::pair<uint64_t, uint64_t> out;
+				while (source.try_pop(out)) {
+					++popped;
+				}
+			});
+		}
+		gdul::concurrent_sorted_list<uint64_t, uint64_t> pieces[4];
+		for (uint64_t i = 0; i < 4; ++i) {
+			source.split_at(9000 - i * 1000, pieces[i]);
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+
+		uint64_t total(popped);
+		for (gdul::concurrent_sorted_list<uint64_t, uint64_t>& piece : pieces) {
+			std::pair<uint64_t, uint64_t> pieceOut;
+			uint64_t previous(0);
+			while (piece.try_pop(pieceOut)) {
+				Assert::IsTrue(previous <= pieceOut.first, L"Out of order piece");
+				previous = pieceOut.first;
+				++total;
+			}
+		}
+		Assert::IsTrue(total == 10000, L"Entries lost or duplicated by split");
+
+		// Front cuts racing pops on the source, and merges racing pops on the 
+		// merged from list, with both sizes checked once quiet
+		gdul::concurrent_sorted_list<uint64_t, uint64_t> front;
+		gdul::concurrent_sorted_list<uint64_t, uint64_t> side;
+		for (uint64_t i = 0; i < 10000; ++i) {
+			front.insert({ i, i });
+		}
+
+		std::atomic<bool> stop(false);
+		std::atomic<uint64_t> racePopped(0);
+		gdul::concurrent_sorted_list<uint64_t, uint64_t>* popFrom(&front);
+		const auto popper([&popFrom, &stop, &racePopped]() {
+			std::pair<uint64_t, uint64_t> out;
+			while (!stop) {
+				if (popFrom->try_pop(out)) {
+					++racePopped;
+				}
+			}
+		});
+
+		threads.clear();
+		for (uint32_t i = 0; i < 4; ++i) {
+			threads.emplace_back(popper);
+		}
+		for (uint64_t round = 0; round < 200; ++round) {
+			const uint64_t moved(front.split_at(round * 50, side));
+			Assert::IsTrue(side.size() == moved, L"Bad suffix size after split");
+			front.merge(std::move(side));
+			Assert::IsTrue(side.size() == 0, L"Merged from list not emptied");
+		}
+		stop = true;
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+
+		stop = false;
+		popFrom = &side;
+		threads.clear();
+		for (uint32_t i = 0; i < 4; ++i) {
+			threads.emplace_back(popper);
+		}
+		for (uint64_t round = 0; round < 200; ++round) {
+			for (uint64_t i = 0; i < 50; ++i) {
+				side.insert({ 10000 + round * 50 + i, i });
+			}
+			front.merge(std::move(side));
+		}
+		stop = true;
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+
+		const uint64_t sideSize(side.size());
+		const uint64_t frontSize(front.size());
+		uint64_t drained(0);
+		std::pair<uint64_t, uint64_t> drainOut;
+		while (side.try_pop(drainOut)) {
+			++drained;
+		}
+		Assert::IsTrue(sideSize == drained, L"Merged from size off after racing pops");
+		while (front.try_pop(drainOut)) {
+			++drained;
+		}
+		Assert::IsTrue(frontSize + sideSize == drained, L"Size off after racing front cuts");
+		Assert::IsTrue(racePopped + drained == 20000, L"Entries lost or duplicated by front cuts");
+
+		// A popped node left linked, with an insert landing ahead of it
+		gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, pop_batch_traits> batched;
+		gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, pop_batch_traits> suffix;
+		batched.insert({ 5, 5 });
+		batched.insert({ 7, 7 });
+		std::pair<uint64_t, uint64_t> batchedOut;
+		Assert::IsTrue(batched.try_pop(batchedOut) && batchedOut.first == 5, L"Bad pop");
+		batched.insert({ 3, 3 });
+		Assert::IsTrue(batched.split_at(6, suffix) == 1, L"Bad split count past a deleted node");
+		Assert::IsTrue(suffix.try_pop(batchedOut) && batchedOut.first == 7 && !suffix.try_pop(batchedOut), L"Bad split suffix");
+		Assert::IsTrue(batched.try_pop(batchedOut) && batchedOut.first == 3 && !batched.try_pop(batchedOut), L"Bad split prefix");
+	}
+	TEST_METHOD(expiry) {
+		gdul::concurrent_sorted_list<uint64_t, std::string, gdul::csldetail::tiny_less, expiry_traits> list;
+
+		std::vector<uint64_t> expired;
+		list.set_expiry_callback([&expired](const uint64_t& key, std::string& value) {
+			Assert::IsTrue(value == std::to_string(key), L"Bad expired value");
+			expired.push_back(key);
+		});
+
+		manual_clock::ourNow = 0;
+
+		const manual_clock::time_point deadline(manual_clock::now() + std::chrono::milliseconds(10));
+		for (uint64_t i = 1; i < 11; ++i) {
+			if (i % 2) {
+				list.insert({ i, std::to_string(i) }, deadline);
+			}
+			else {
+				list.insert({ i, std::to_string(i) });
+			}
+		}
+
+		list.insert({ 100, "100" });
+		Assert::IsTrue(expired.empty(), L"Expired early");
+
+		manual_clock::ourNow = 10;
+
+		// Walks past every entry, unlinking the odd ones
+		list.insert({ 101, "101" });
+		Assert::IsTrue(expired.size() == 5 && list.size() == 7, L"Expired entries left in place");
+
+		list.insert({ 0, "0" }, deadline);
+
+		std::pair<uint64_t, std::string> out;
+		for (uint64_t i = 2; i < 11; i += 2) {
+			Assert::IsTrue(list.try_pop(out) && out.first == i, L"Popped expired entry");
+		}
+		Assert::IsTrue(expired.size() == 6 && expired.back() == 0, L"Pop did not expire front");
+		Assert::IsTrue(list.try_pop(out) && out.first == 100, L"Bad pop");
+		Assert::IsTrue(list.try_pop(out) && out.first == 101, L"Bad pop");
+		Assert::IsFalse(list.try_pop(out), L"List not drained");
+		Assert::IsTrue(list.size() == 0, L"Bad size");
+	}
+	TEST_METHOD(bounded_top_k) {
+		gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, top_k_traits> list;
+
+		std::vector<uint64_t> keys;
+		for (uint64_t i = 0; i < 1000; ++i) {
+			keys.push_back(i);
+		}
+		std::shuffle(keys.begin(), keys.end(), std::default_random_engine(5));
+
+		for (uint64_t key : keys) {
+			list.insert({ key, key });
+		}
+		Assert::IsTrue(list.size() == 100, L"Capacity exceeded");
+		Assert::IsFalse(list.insert({ 100, 100 }), L"Accepted key beyond the worst");
+		Assert::IsTrue(list.insert({ 50, 50 }), L"Turned away better key");
+		Assert::IsTrue(list.size() == 100, L"Capacity exceeded");
+
+		std::pair<uint64_t, uint64_t> out;
+		for (uint64_t i = 0; i < 100; ++i) {
+			Assert::IsTrue(list.try_pop(out) && out.first == (i <= 50 ? i : i - 1), L"Bad top k");
+		}
+		Assert::IsFalse(list.try_pop(out), L"List not drained");
+
+		std::vector<std::thread> threads;
+		for (uint32_t i = 0; i < 4; ++i) {
+			threads.emplace_back([&list, i]() {
+				std::default_random_engine rng(i);
+				std::uniform_int_distribution<uint64_t> dist(0, 100000);
+				for (uint32_t j = 0; j < 5000; ++j) {
+					const uint64_t key(dist(rng) * 4 + i);
+					list.insert({ key, key });
+				}
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		Assert::IsTrue(list.size() == 100, L"Capacity exceeded under concurrency");
+
+		uint64_t last(0);
+		uint64_t count(0);
+		while (list.try_pop(out)) {
+			Assert::IsTrue(last <= out.first, L"Out of order");
+			last = out.first;
+			++count;
+		}
+		Assert::IsTrue(count == 100, L"Bad count");
+	}
+	TEST_METHOD(range_partitioned) {
+		gdul::range_partitioned_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, gdul::csl_default_traits, 4> list(0, 100000);
+
+		// Skewed into the first shard, which should then hand on entries
+		for (uint64_t i = 0; i < 4000; ++i) {
+			list.insert({ (i * 7919) % 4000, i });
+		}
+		Assert::IsTrue(list.size() == 4000, L"Bad size");
+		Assert::IsTrue(list.shard(0).size() < 3000, L"Shards were not rebalanced");
+		Assert::IsTrue(list.split_key(0) <= list.split_key(1) && list.split_key(1) <= list.split_key(2), L"Split keys out of order");
+
+		std::vector<std::thread> threads;
+		for (uint32_t i = 0; i < 4; ++i) {
+			threads.emplace_back([&list, i]() {
+				std::default_random_engine rng(i);
+				std::uniform_int_distribution<uint64_t> dist(0, 100000);
+				std::pair<uint64_t, uint64_t> out;
+				for (uint32_t j = 0; j < 4000; ++j) {
+					list.insert({ dist(rng), j });
+					if (j % 2) {
+						list.try_pop(out);
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		Assert::IsTrue(list.size() == 4000 + 8000, L"Bad size after concurrent use");
+
+		std::pair<uint64_t, uint64_t> out;
+		uint64_t last(0);
+		uint64_t count(0);
+		while (list.try_pop(out)) {
+			Assert::IsTrue(last <= out.first, L"Out of order across shards");
+			last = out.first;
+			++count;
+		}
+		Assert::IsTrue(count == 12000, L"Bad count");
+
+		// A range spanning the whole of a signed key type
+		gdul::range_partitioned_sorted_list<int64_t, uint64_t, gdul::csldetail::tiny_less, gdul::csl_default_traits, 4> wide((std::numeric_limits<int64_t>::min)(), (std::numeric_limits<int64_t>::max)());
+		Assert::IsTrue(wide.split_key(0) < wide.split_key(1) && wide.split_key(1) < wide.split_key(2), L"Split keys overflowed");
+		Assert::IsTrue(wide.split_key(0) < 0 && 0 < wide.split_key(2), L"Uneven split keys");
+
+		// Skewed towards the top shard, which then hands its lower entries down
+		for (int64_t i = 0; i < 4000; ++i) {
+			wide.insert({ (std::numeric_limits<int64_t>::max)() - (i * 7919) % 4000, static_cast<uint64_t>(i) });
+		}
+		Assert::IsTrue(wide.shard(3).size() < 3000 && wide.size() == 4000, L"Shards were not rebalanced downwards");
+		Assert::IsTrue(wide.split_key(0) <= wide.split_key(1) && wide.split_key(1) <= wide.split_key(2), L"Split keys out of order");
+
+		std::pair<int64_t, uint64_t> wideOut;
+		for (int64_t i = 0; i < 4000; ++i) {
+			Assert::IsTrue(wide.try_pop(wideOut) && wideOut.first == (std::numeric_limits<int64_t>::max)() - 3999 + i, L"Out of order after rebalancing");
+		}
+		Assert::IsFalse(wide.try_pop(wideOut), L"Popped from empty list");
+	}
+	TEST_METHOD(erase_range) {
+		gdul::concurrent_sorted_list<uint64_t, uint64_t> list;
+
+		for (uint64_t i = 0; i < 1000; ++i) {
+			list.insert({ i, i });
+		}
+
+		Assert::IsTrue(list.erase_range(100, 200) == 100, L"Bad erase count");
+		Assert::IsTrue(list.erase_range(150, 180) == 0, L"Erased twice");
+		Assert::IsTrue(list.erase_range(0, 10) == 10, L"Bad erase count at front");
+		Assert::IsTrue(list.size() == 890, L"Bad size");
+
+		std::pair<uint64_t, uint64_t> out;
+		for (uint64_t i = 10; i < 1000; ++i) {
+			if (i == 100) {
+				i = 200;
+			}
+			Assert::IsTrue(list.try_pop(out) && out.first == i, L"Bad order after erase");
+		}
+
+		// Erases racing pops at the front and inserts into the erased range
+		for (uint64_t i = 0; i < 10000; ++i) {
+			list.insert({ i * 2, i });
+		}
+
+		std::atomic<uint64_t> popped(0);
+		std::thread popper([&list, &popped]() {
+			std::pair<uint64_t, uint64_t> out;
+			for (uint32_t i = 0; i < 3000; ++i) {
+				popped += list.try_pop(out);
+			}
+		});
+		std::thread inserter([&list]() {
+			for (uint64_t i = 0; i < 3000; ++i) {
+				list.insert({ 4001 + i * 2, i });
+			}
+		});
+
+		uint64_t erased(0);
+		for (uint64_t i = 0; i < 10; ++i) {
+			erased += list.erase_range(i * 2000, i * 2000 + 1000);
+		}
+		popper.join();
+		inserter.join();
+
+		uint64_t remaining(0);
+		uint64_t last(0);
+		while (list.try_pop(out)) {
+			Assert::IsTrue(out.first % 2 || 1000 <= out.first % 2000, L"Erased entry survived");
+			Assert::IsTrue(last <= out.first, L"Out of order");
+			last = out.first;
+			++remaining;
+		}
+		Assert::IsTrue(popped + erased + remaining == 13000, L"Entries lost or duplicated by erase");
+
+		// A popped node left linked, with an insert landing ahead of it
+		gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, pop_batch_traits> batched;
+		batched.insert({ 5, 5 });
+		batched.insert({ 7, 7 });
+		Assert::IsTrue(batched.try_pop(out) && out.first == 5, L"Bad pop");
+		batched.insert({ 3, 3 });
+		Assert::IsTrue(batched.erase_range(6, 10) == 1, L"Bad erase count past a deleted node");
+		Assert::IsTrue(batched.try_pop(out) && out.first == 3 && !batched.try_pop(out), L"Bad contents after erase");
+	}
+	TEST_METHOD(rank_select) {
+		gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, order_statistics_traits> list;
+
+		std::vector<uint64_t> keys;
+		for (uint64_t i = 0; i < 2000; ++i) {
+			keys.push_back(i * 2);
+		}
+		std::shuffle(keys.begin(), keys.end(), std::default_random_engine(3));
+		for (uint64_t key : keys) {
+			list.insert({ key, key });
+		}
+
+		uint64_t key(0);
+		Assert::IsTrue(list.rank(0) == 0, L"Bad rank");
+		Assert::IsTrue(list.rank(1000) == 500, L"Bad rank");
+		Assert::IsTrue(list.rank(1001) == 501, L"Bad rank");
+		Assert::IsTrue(list.select(500, key) && key == 1000, L"Bad select");
+		Assert::IsFalse(list.select(2000, key), L"Selected past the end");
+
+		// Estimates stay within a couple of strides, through inserts counted 
+		// into their segments and pops taken off the front
+		auto check = [&list]() {
+			const std::ptrdiff_t tolerance(32);
+			uint64_t key(0);
+			for (uint64_t k = 0; k < 6000; k += 37) {
+				const std::ptrdiff_t error(static_cast<std::ptrdiff_t>(list.rank_approx(k)) - static_cast<std::ptrdiff_t>(list.rank(k)));
+				Assert::IsTrue(-tolerance <= error && error <= tolerance, L"rank_approx off");
+			}
+			for (std::size_t k = 0; k < list.size(); k += 37) {
+				Assert::IsTrue(list.select_approx(k, key), L"select_approx failed");
+				const std::ptrdiff_t error(static_cast<std::ptrdiff_t>(list.rank(key)) - static_cast<std::ptrdiff_t>(k));
+				Assert::IsTrue(-tolerance <= error && error <= tolerance, L"select_approx off");
+			}
+			Assert::IsFalse(list.select_approx(list.size(), key), L"Selected past the end");
+		};
+
+		list.rebuild_index();
+		check();
+
+		std::default_random_engine rng(5);
+		std::uniform_int_distribution<uint64_t> dist(0, 6000);
+		for (uint32_t i = 0; i < 1000; ++i) {
+			const uint64_t key(dist(rng) | 1);
+			list.insert({ key, key });
+		}
+		check();
+
+		std::pair<uint64_t, uint64_t> out;
+		for (uint32_t i = 0; i < 1000; ++i) {
+			list.try_pop(out);
+		}
+		check();
+	}
+	TEST_METHOD(key_quantile) {
+		gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, quantile_traits> list;
+
+		uint64_t key(0);
+		Assert::IsFalse(list.key_quantile(0.5, key), L"Quantile of empty list");
+
+		std::vector<uint64_t> keys;
+		for (uint64_t i = 0; i < 10000; ++i) {
+			keys.push_back(i);
+		}
+		std::shuffle(keys.begin(), keys.end(), std::default_random_engine(11));
+		for (uint64_t k : keys) {
+			list.insert({ k, k });
+		}
+
+		Assert::IsTrue(list.key_quantile(0.5, key) && 4800 < key && key < 5200, L"Bad median");
+		Assert::IsTrue(list.key_quantile(0.99, key) && 9700 < key, L"Bad 99th percentile");
+
+		// Pops take the low half away
+		std::pair<uint64_t, uint64_t> out;
+		for (uint32_t i = 0; i < 5000; ++i) {
+			list.try_pop(out);
+		}
+		Assert::IsTrue(list.key_quantile(0.5, key) && 7300 < key && key < 7700, L"Median ignored pops");
+
+		std::vector<std::thread> threads;
+		for (uint32_t i = 0; i < 4; ++i) {
+			threads.emplace_back([&list, i]() {
+				std::default_random_engine rng(i);
+				std::uniform_int_distribution<uint64_t> dist(0, 100000);
+				std::pair<uint64_t, uint64_t> out;
+				for (uint32_t j = 0; j < 5000; ++j) {
+					const uint64_t k(dist(rng));
+					list.insert({ k, k });
+					if (j % 2) {
+						list.try_pop(out);
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+
+		// Against the exact answer, within a fraction of the key range
+		for (double q : { 0.1, 0.5, 0.9 }) {
+			uint64_t exact(0);
+			list.select(static_cast<std::size_t>(q * list.size()), exact);
+			Assert::IsTrue(list.key_quantile(q, key), L"No quantile");
+			const int64_t error(static_cast<int64_t>(key) - static_cast<int64_t>(exact));
+			Assert::IsTrue(-2000 < error && error < 2000, L"Quantile off");
+		}
+	}
+	TEST_METHOD(merged_view) {
+		typedef gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, publish_traits> list_type;
+
+		list_type lists[4];
+		gdul::merged_view<list_type> view;
+
+		std::size_t handles[4];
+		for (std::size_t i = 0; i < 4; ++i) {
+			handles[i] = view.add_source(lists[i]);
+		}
+		Assert::IsTrue(view.sources() == 4, L"Bad source count");
+
+		auto fill = [&lists]() {
+			for (uint64_t i = 0; i < 1000; ++i) {
+				lists[i % 4].insert({ i, i });
+			}
+		};
+
+		fill();
+
+		std::pair<uint64_t, uint64_t> out;
+		for (uint64_t i = 0; i < 1000; ++i) {
+			Assert::IsTrue(view.try_pop(out) && out.first == i, L"Not the global minimum");
+		}
+		Assert::IsFalse(view.try_pop(out), L"Popped from empty sources");
+
+		fill();
+		view.remove_source(handles[2]);
+		uint32_t popped(0);
+		while (view.try_pop(out)) {
+			Assert::IsTrue(out.first % 4 != 2, L"Popped from removed source");
+			++popped;
+		}
+		Assert::IsTrue(popped == 750 && lists[2].size() == 250, L"Entries lost");
+
+		handles[2] = view.add_source(lists[2]);
+		Assert::IsTrue(view.try_pop(out) && out.first == 2, L"Readded source not popped");
+		while (view.try_pop(out));
+
+		// Producers feed their own source while the view pops
+		const uint64_t perProducer(5000);
+		std::atomic<bool> done(false);
+		std::vector<std::thread> producers;
+		for (uint64_t i = 0; i < 4; ++i) {
+			producers.emplace_back([&lists, i, perProducer]() {
+				for (uint64_t j = 0; j < perProducer; ++j) {
+					lists[i].insert({ j * 4 + i, j });
+				}
+			});
+		}
+
+		uint64_t next[4] = {};
+		uint64_t total(0);
+		while (total < perProducer * 4) {
+			if (!view.try_pop(out)) {
+				std::this_thread::yield();
+				continue;
+			}
+			const uint64_t source(out.first % 4);
+			Assert::IsTrue(out.second == next[source]++, L"Source popped out of order");
+			++total;
+		}
+		for (std::thread& producer : producers) {
+			producer.join();
+		}
+		Assert::IsFalse(view.try_pop(out), L"Popped more than inserted");
+
+		// Fronts changed around the view are seen, without Publish_Top_Key too
+		typedef gdul::concurrent_sorted_list<uint64_t, uint64_t> plain_type;
+		plain_type plain[2];
+		gdul::merged_view<plain_type> plainView;
+		plainView.add_source(plain[0]);
+		plainView.add_source(plain[1]);
+
+		plain[0].insert({ 10, 10 });
+		plain[1].insert({ 20, 20 });
+
+		uint64_t top(0);
+		Assert::IsTrue(plainView.try_peek_top_key(top) && top == 10, L"Bad top key");
+		plain[1].insert({ 5, 5 });
+		Assert::IsTrue(plainView.try_peek_top_key(top) && top == 5, L"Insert at the front missed");
+		Assert::IsTrue(plain[1].try_pop(out) && out.first == 5, L"Bad pop");
+		Assert::IsTrue(plainView.try_peek_top_key(top) && top == 10, L"Pop from the source missed");
+
+		Assert::IsTrue(plainView.try_pop(out) && out.first == 10, L"Not the global minimum");
+		Assert::IsTrue(plainView.try_pop(out) && out.first == 20, L"Not the global minimum");
+		Assert::IsFalse(plainView.try_pop(out), L"Popped from empty sources");
+	}
+	TEST_METHOD(tournament_queue) {
+		gdul::tournament_queue<uint64_t, uint64_t> queue;
+
+		std::vector<std::thread> producers;
+		for (uint64_t i = 0; i < 4; ++i) {
+			producers.emplace_back([&queue, i]() {
+				for (uint64_t j = 0; j < 1000; ++j) {
+					queue.push({ j * 4 + i, j });
+				}
+			});
+		}
+		for (std::thread& producer : producers) {
+			producer.join();
+		}
+		Assert::IsTrue(queue.size() == 4000, L"Bad size");
+
+		std::pair<uint64_t, uint64_t> out;
+		for (uint64_t i = 0; i < 4000; ++i) {
+			Assert::IsTrue(queue.try_pop(out) && out.first == i, L"Not the global minimum");
+		}
+		Assert::IsFalse(queue.try_pop(out), L"Popped from empty queue");
+
+		// Producers and consumers at once. Each producer's entries come out in order
+		producers.clear();
+		for (uint64_t i = 0; i < 4; ++i) {
+			producers.emplace_back([&queue, i]() {
+				for (uint64_t j = 0; j < 20000; ++j) {
+					queue.push({ j * 4 + i, j });
+				}
+			});
+		}
+
+		std::atomic<uint64_t> popped(0);
+		std::vector<std::thread> consumers;
+		for (uint32_t i = 0; i < 2; ++i) {
+			consumers.emplace_back([&queue, &popped]() {
+				uint64_t last[4] = {};
+				bool seen[4] = {};
+				std::pair<uint64_t, uint64_t> out;
+				while (popped < 80000) {
+					if (!queue.try_pop(out)) {
+						std::this_thread::yield();
+						continue;
+					}
+					const uint64_t producer(out.first % 4);
+					Assert::IsTrue(!seen[producer] || last[producer] < out.second, L"Producer out of order");
+					seen[producer] = true;
+					last[producer] = out.second;
+					++popped;
+				}
+			});
+		}
+		for (std::thread& producer : producers) {
+			producer.join();
+		}
+		for (std::thread& consumer : consumers) {
+			consumer.join();
+		}
+		Assert::IsTrue(popped == 80000 && queue.size() == 0 && !queue.try_pop(out), L"Entries lost");
+
+		for (uint64_t i = 0; i < 100; ++i) {
+			queue.push({ i, i });
+		}
+		queue.unsafe_clear();
+		Assert::IsTrue(queue.size() == 0 && !queue.try_pop(out), L"Clear left entries");
+
+		// Short lived queues reuse the thread local slots, and producers past
+		// the limit are turned away
+		for (uint64_t i = 0; i < 100; ++i) {
+			gdul::tournament_queue<uint64_t, uint64_t, gdul::csldetail::tiny_less, 2> small;
+			small.push({ i, i });
+			small.push({ i + 1, i });
+
+			bool turnedAway(false);
+			std::thread([&small]() { small.push({ 0, 0 }); }).join();
+			std::thread([&small, &turnedAway]() {
+				try {
+					small.push({ 0, 0 });
+				}
+				catch (const std::length_error&) {
+					turnedAway = true;
+				}
+			}).join();
+
+			Assert::IsTrue(turnedAway && small.size() == 3, L"Producer limit not enforced");
+			Assert::IsTrue(small.try_pop(out) && out.first == 0 && small.try_pop(out) && out.first == i, L"Bad pop order");
+		}
+	}
+	TEST_METHOD(bitmap_priority_queue) {
+		gdul::bitmap_priority_queue<uint16_t, uint32_t> queue;
+
+		const uint16_t levels[] = { 4000, 7, 65535, 0, 64, 63, 4095, 4096 };
+		for (uint32_t i = 0; i < 3; ++i) {
+			for (uint16_t level : levels) {
+				queue.insert({ level, i });
+			}
+		}
+		Assert::IsTrue(queue.size() == 24, L"Bad size");
+
+		uint16_t top(0);
+		Assert::IsTrue(queue.try_peek_top_key(top) && top == 0, L"Bad top key");
+
+		// Lowest level first, in insertion order within a level
+		std::pair<uint16_t, uint32_t> out;
+		const uint16_t sorted[] = { 0, 7, 63, 64, 4000, 4095, 4096, 65535 };
+		for (uint16_t level : sorted) {
+			for (uint32_t i = 0; i < 3; ++i) {
+				Assert::IsTrue(queue.try_pop(out) && out.first == level && out.second == i, L"Bad pop order");
+			}
+		}
+		Assert::IsFalse(queue.try_pop(out) || queue.try_peek_top_key(top), L"Popped from empty queue");
+
+		// Producers and consumers at once. Nothing may be lost to a level 
+		// being marked vacant
+		std::atomic<uint32_t> popped(0);
+		std::vector<std::thread> threads;
+		for (uint32_t i = 0; i < 4; ++i) {
+			threads.emplace_back([&queue, i]() {
+				for (uint32_t j = 0; j < 10000; ++j) {
+					queue.insert({ static_cast<uint16_t>((j * 4 + i) % 200), j });
+				}
+			});
+		}
+		for (uint32_t i = 0; i < 2; ++i) {
+			threads.emplace_back([&queue, &popped]() {
+				std::pair<uint16_t, uint32_t> out;
+				while (popped < 40000) {
+					if (queue.try_pop(out)) {
+						++popped;
+					}
+					else {
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		Assert::IsTrue(popped == 40000 && queue.size() == 0 && !queue.try_pop(out), L"Entries lost");
+
+		queue.insert({ 9, 1 });
+		queue.unsafe_clear();
+		Assert::IsFalse(queue.try_pop(out) || queue.size(), L"Not cleared");
+	}
+	TEST_METHOD(calendar_queue) {
+		gdul::concurrent_calendar_queue<double, uint32_t> queue;
+
+		std::default_random_engine rng(7);
+		std::uniform_real_distribution<double> dist(0.0, 1000.0);
+		for (uint32_t i = 0; i < 5000; ++i) {
+			queue.insert({ dist(rng), i });
+		}
+		Assert::IsTrue(queue.size() == 5000, L"Bad size");
+		Assert::IsTrue(16 < queue.unsafe_day_count() && queue.unsafe_day_width() != 1.0, L"Days were not redrawn");
+
+		std::pair<double, uint32_t> out;
+		double last(-1.0);
+		for (uint32_t i = 0; i < 5000; ++i) {
+			double top(0.0);
+			Assert::IsTrue(queue.try_peek_top_key(top) && queue.try_pop(out) && top == out.first, L"Bad top key");
+			Assert::IsTrue(last <= out.first, L"Out of order");
+			last = out.first;
+		}
+		Assert::IsFalse(queue.try_pop(out), L"Popped from empty queue");
+
+		// Signed keys on both sides of the origin
+		gdul::concurrent_calendar_queue<int32_t, int32_t> signedQueue;
+		for (int32_t i = 0; i < 1000; ++i) {
+			signedQueue.insert({ (i * 7919) % 1000 - 500, i });
+		}
+		std::pair<int32_t, int32_t> signedOut;
+		for (int32_t i = -500; i < 500; ++i) {
+			Assert::IsTrue(signedQueue.try_pop(signedOut) && signedOut.first == i, L"Out of order with signed keys");
+		}
+
+		// Hold model, each pop scheduling a later event
+		for (uint32_t i = 0; i < 1000; ++i) {
+			queue.insert({ dist(rng), i });
+		}
+		std::vector<std::thread> threads;
+		for (uint32_t i = 0; i < 4; ++i) {
+			threads.emplace_back([&queue, i]() {
+				std::default_random_engine rng(i);
+				std::exponential_distribution<double> gap(1.0);
+				std::pair<double, uint32_t> out;
+				for (uint32_t j = 0; j < 5000; ++j) {
+					if (queue.try_pop(out)) {
+						queue.insert({ out.first + gap(rng), j });
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		Assert::IsTrue(queue.size() == 1000, L"Bad size after concurrent use");
+
+		last = -1.0;
+		uint32_t count(0);
+		while (queue.try_pop(out)) {
+			Assert::IsTrue(last <= out.first, L"Out of order after concurrent use");
+			last = out.first;
+			++count;
+		}
+		Assert::IsTrue(count == 1000, L"Bad count");
+	}
+	TEST_METHOD(pop_batching) {
+		gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, pop_batch_traits> list;
+
+		for (uint64_t i = 0; i < 100; ++i) {
+			list.insert({ i, i });
+		}
+
+		// Fewer than the threshold, so the deleted nodes stay at the front
+		std::pair<uint64_t, uint64_t> out;
+		for (uint64_t i = 0; i < 5; ++i) {
+			Assert::IsTrue(list.try_pop(out) && out.first == i, L"Bad pop order");
+		}
+		uint64_t top(0);
+		Assert::IsTrue(list.try_peek_top_key(top) && top == 5, L"Top key behind deleted nodes");
+
+		out.first = 6;
+		Assert::IsFalse(list.compare_try_pop(out), L"Popped a mismatched key");
+		Assert::IsTrue(out.first == 5 && list.compare_try_pop(out) && out.first == 5, L"Bad compare pop");
+
+		// Inserts landing among and behind the deleted nodes
+		list.insert({ 2, 200 });
+		list.insert({ 6, 600 });
+		Assert::IsTrue(list.try_pop(out) && out.first == 2 && list.size() == 95, L"Insert among deleted nodes lost");
+
+		Assert::IsTrue(list.erase_range(10, 20) == 10, L"Bad erase count");
+		Assert::IsTrue(list.size_exact() == 85, L"Bad size after erase");
+
+		for (uint64_t i = 0; i < 85; ++i) {
+			Assert::IsTrue(list.try_pop(out), L"Entries lost");
+		}
+		Assert::IsFalse(list.try_pop(out) || list.try_peek_top_key(top), L"Popped from empty list");
+
+		// Producers and consumers at once
+		std::atomic<uint64_t> popped(0);
+		std::vector<std::thread> threads;
+		for (uint64_t i = 0; i < 4; ++i) {
+			threads.emplace_back([&list, i]() {
+				for (uint64_t j = 0; j < 10000; ++j) {
+					list.insert({ j * 4 + i, j });
+				}
+			});
+		}
+		for (uint32_t i = 0; i < 4; ++i) {
+			threads.emplace_back([&list, &popped]() {
+				std::pair<uint64_t, uint64_t> out;
+				while (popped < 40000) {
+					if (list.try_pop(out)) {
+						++popped;
+					}
+					else {
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		Assert::IsTrue(popped == 40000 && list.size() == 0 && list.size_exact() == 0 && !list.try_pop(out), L"Entries lost under contention");
+
+		// Each pop leaves its node linked, and an insert lands ahead of it
+		for (uint64_t i = 0; i < 50; ++i) {
+			list.insert({ 100 + i, i });
+		}
+		for (uint64_t i = 0; i < 20; ++i) {
+			Assert::IsTrue(list.try_pop(out) && out.first == (i ? 100 - i : 100), L"Bad pop order with front inserts");
+			list.insert({ 99 - i, i });
+		}
+		Assert::IsTrue(list.erase_range(120, 130) == 10, L"Bad erase count past deleted runs");
+
+		gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, pop_batch_traits> suffix;
+		Assert::IsTrue(list.split_at(140, suffix) == 10 && suffix.size() == 10, L"Bad split count past deleted runs");
+		Assert::IsTrue(list.size_exact() == 30, L"Bad size after range operations");
+
+		uint64_t last(0);
+		for (uint64_t i = 0; i < 30; ++i) {
+			Assert::IsTrue(list.try_pop(out) && last <= out.first && (out.first < 120 || 130 <= out.first), L"Bad contents after range operations");
+			last = out.first;
+		}
+		Assert::IsFalse(list.try_pop(out), L"Popped from empty list");
+	}
+
+	TEST_METHOD(chunked_priority_queue) {
+		// Small chunks, to have them split and absorbed often
+		gdul::chunked_priority_queue<uint32_t, uint32_t, gdul::csldetail::tiny_less, 16> queue;
+
+		std::vector<uint32_t> keys;
+		for (uint32_t i = 0; i < 1000; ++i) {
+			keys.push_back((i * 7919) % 500);
+			queue.insert({ keys.back(), i });
+		}
+		Assert::IsTrue(queue.size() == 1000, L"Bad size");
+		Assert::IsTrue(1 < queue.unsafe_chunk_count(), L"Chunks were not split");
+
+		// Smaller keys interleaved, going by way of the buffer chunk
+		std::sort(keys.begin(), keys.end());
+		std::pair<uint32_t, uint32_t> out;
+		for (uint32_t i = 0; i < 500; ++i) {
+			uint32_t top(0);
+			Assert::IsTrue(queue.try_peek_top_key(top) && queue.try_pop(out) && top == out.first && out.first == keys[i], L"Out of order");
+		}
+		for (uint32_t i = 0; i < 300; ++i) {
+			keys.push_back((i * 31) % 500);
+			queue.insert({ keys.back(), i });
+		}
+		std::sort(keys.begin() + 500, keys.end());
+		for (uint32_t i = 500; i < 1300; ++i) {
+			Assert::IsTrue(queue.try_pop(out) && out.first == keys[i], L"Out of order after inserting before the top");
+		}
+		Assert::IsFalse(queue.try_pop(out), L"Popped from empty queue");
+
+		std::vector<std::thread> threads;
+		std::atomic<uint32_t> popped(0);
+		for (uint32_t i = 0; i < 4; ++i) {
+			threads.emplace_back([&queue, &popped, i]() {
+				std::default_random_engine rng(i);
+				std::pair<uint32_t, uint32_t> out;
+				for (uint32_t j = 0; j < 5000; ++j) {
+					queue.insert({ rng() % 1000, j });
+					if (j % 2 && queue.try_pop(out)) {
+						++popped;
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+
+		uint32_t last(0);
+		while (queue.try_pop(out)) {
+			Assert::IsTrue(last <= out.first, L"Out of order after concurrent use");
+			last = out.first;
+			++popped;
+		}
+		Assert::IsTrue(popped == 20000, L"Entries lost under contention");
+	}
 };
 }
\ No newline at end of file
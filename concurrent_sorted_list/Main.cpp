@@ -1,11 +1,433 @@
 
 #include "pch.h"
 #include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <random>
+#include <map>
+#include <memory>
+#include "concurrent_sorted_list.h"
+#include "range_partitioned_sorted_list.h"
+#include "tournament_queue.h"
+#include "bitmap_priority_queue.h"
+#include "concurrent_calendar_queue.h"
+#include "chunked_priority_queue.h"
 
 //#include <vld.h>
 
-int main()
+namespace
+{
+// Sharded size and stats counters, so that their padding is measured too
+struct padding_64_traits : gdul::csl_default_traits
+{
+	static constexpr std::size_t Cache_Line_Size = 64;
+	typedef gdul::csl_sharded_size<> size_policy;
+	typedef gdul::csl_atomic_stats<> stats_policy;
+};
+struct padding_128_traits : gdul::csl_default_traits
+{
+	static constexpr std::size_t Cache_Line_Size = 128;
+	typedef gdul::csl_sharded_size<> size_policy;
+	typedef gdul::csl_atomic_stats<> stats_policy;
+};
+struct sharded_size_traits : gdul::csl_default_traits
+{
+	typedef gdul::csl_sharded_size<> size_policy;
+};
+struct prefetch_1_traits : gdul::csl_default_traits
+{
+	static constexpr std::size_t Prefetch_Distance = 1;
+};
+struct prefetch_2_traits : gdul::csl_default_traits
+{
+	static constexpr std::size_t Prefetch_Distance = 2;
+};
+struct jump_index_traits : gdul::csl_default_traits
+{
+	static constexpr std::size_t Jump_Index_Stride = 64;
+};
+struct pop_batch_traits : gdul::csl_default_traits
+{
+	static constexpr std::size_t Pop_Batch_Threshold = 4;
+};
+struct quantile_traits : gdul::csl_default_traits
+{
+	typedef gdul::csl_quantile_sketch<> quantile_policy;
+};
+struct std_allocator_traits : gdul::csl_default_traits
+{
+	typedef std::allocator<uint8_t> allocator_type;
+};
+
+const uint32_t Num_Threads = 8;
+const uint32_t Ops_Per_Thread = 20000;
+
+// Runs work(threadIndex) on Num_Threads threads and returns the
+// average number of nanoseconds spent per operation
+template <class Work>
+double run_threads(Work&& work)
+{
+	std::vector<std::thread> threads;
+	std::atomic<bool> begin(false);
+
+	for (uint32_t i = 0; i < Num_Threads; ++i) {
+		threads.emplace_back([&work, &begin, i]() {
+			while (!begin) {
+				std::this_thread::yield();
+			}
+			work(i);
+		});
+	}
+
+	const std::chrono::high_resolution_clock::time_point start(std::chrono::high_resolution_clock::now());
+	begin = true;
+
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	const std::chrono::duration<double, std::nano> elapsed(std::chrono::high_resolution_clock::now() - start);
+
+	return elapsed.count() / (Num_Threads * Ops_Per_Thread);
+}
+
+// All threads insert and pop at the front of the same list, hammering
+// the size counter and front link
+template <class Traits>
+double shared_list()
+{
+	gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, Traits> list;
+
+	return run_threads([&list](uint32_t threadIndex) {
+		std::pair<uint64_t, uint64_t> out;
+		for (uint32_t i = 0; i < Ops_Per_Thread / 2; ++i) {
+			list.insert({ threadIndex, i });
+			list.try_pop(out);
+		}
+	});
+}
+
+// Every thread owns one list in a contiguous array, so that only padding
+// keeps the threads from sharing lines with their neighbours
+template <class Traits>
+double adjacent_lists()
+{
+	typedef gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, Traits> list_type;
+
+	std::vector<list_type> lists(Num_Threads);
+
+	return run_threads([&lists](uint32_t threadIndex) {
+		list_type& list(lists[threadIndex]);
+		std::pair<uint64_t, uint64_t> out;
+		for (uint32_t i = 0; i < Ops_Per_Thread / 2; ++i) {
+			list.insert({ i, i });
+			list.try_pop(out);
+		}
+	});
+}
+
+// Prefills a list and times a single thread draining it
+template <class Traits>
+double drain()
+{
+	gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, Traits> list;
+
+	const uint32_t entries(Num_Threads * Ops_Per_Thread);
+	for (uint32_t i = 0; i < entries; ++i) {
+		list.insert({ entries - i, i });
+	}
+
+	std::pair<uint64_t, uint64_t> out;
+
+	const std::chrono::high_resolution_clock::time_point start(std::chrono::high_resolution_clock::now());
+	while (list.try_pop(out));
+	const std::chrono::duration<double, std::nano> elapsed(std::chrono::high_resolution_clock::now() - start);
+
+	return elapsed.count() / entries;
+}
+
+// Prefills a list and times all threads draining it at once
+template <class Traits>
+double drain_concurrent()
+{
+	gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, Traits> list;
+
+	const uint32_t entries(Num_Threads * Ops_Per_Thread);
+	for (uint32_t i = 0; i < entries; ++i) {
+		list.insert({ entries - i, i });
+	}
+
+	return run_threads([&list](uint32_t) {
+		std::pair<uint64_t, uint64_t> out;
+		for (uint32_t i = 0; i < Ops_Per_Thread; ++i) {
+			list.try_pop(out);
+		}
+	});
+}
+double drain_concurrent_chunked()
+{
+	gdul::chunked_priority_queue<uint64_t, uint64_t> queue;
+
+	const uint32_t entries(Num_Threads * Ops_Per_Thread);
+	for (uint32_t i = 0; i < entries; ++i) {
+		queue.insert({ entries - i, i });
+	}
+
+	return run_threads([&queue](uint32_t) {
+		std::pair<uint64_t, uint64_t> out;
+		for (uint32_t i = 0; i < Ops_Per_Thread; ++i) {
+			queue.try_pop(out);
+		}
+	});
+}
+
+// Times a single threaded build from sorted input followed by a full
+// drain, through unsafe_insert_sorted and unsafe_try_pop
+template <class Traits>
+double exclusive_phase_list()
+{
+	gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, Traits> list;
+
+	const uint32_t entries(Num_Threads * Ops_Per_Thread);
+	std::vector<std::pair<uint64_t, uint64_t>> input;
+	for (uint32_t i = 0; i < entries; ++i) {
+		input.push_back({ i, i });
+	}
+
+	std::pair<uint64_t, uint64_t> out;
+
+	const std::chrono::high_resolution_clock::time_point start(std::chrono::high_resolution_clock::now());
+	list.unsafe_insert_sorted(input.begin(), input.end());
+	while (list.unsafe_try_pop(out));
+	const std::chrono::duration<double, std::nano> elapsed(std::chrono::high_resolution_clock::now() - start);
+
+	return elapsed.count() / entries;
+}
+
+// The same work as exclusive_phase_list, on std::multimap
+double exclusive_phase_multimap()
 {
-	std::cout << "hello" << std::endl;
+	std::multimap<uint64_t, uint64_t> map;
+
+	const uint32_t entries(Num_Threads * Ops_Per_Thread);
+	std::vector<std::pair<uint64_t, uint64_t>> input;
+	for (uint32_t i = 0; i < entries; ++i) {
+		input.push_back({ i, i });
+	}
+
+	const std::chrono::high_resolution_clock::time_point start(std::chrono::high_resolution_clock::now());
+	for (const std::pair<uint64_t, uint64_t>& in : input) {
+		map.emplace_hint(map.end(), in);
+	}
+	while (!map.empty()) {
+		map.erase(map.begin());
+	}
+	const std::chrono::duration<double, std::nano> elapsed(std::chrono::high_resolution_clock::now() - start);
+
+	return elapsed.count() / entries;
+}
+
+// Times inserts at the back of a list of the given length, and returns the 
+// average number of nanoseconds spent per traversed node. The list's nodes
+// are interleaved in memory with those of other lists drawing from the same 
+// pool, so that traversal does not walk memory sequentially
+template <class Traits>
+double traversal(uint32_t length)
+{
+	typedef gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, Traits> list_type;
+
+	const uint32_t interleave(64);
+	const uint32_t inserts(16);
+
+	typename list_type::pool_type pool(1024);
+
+	std::vector<std::unique_ptr<list_type>> lists;
+	for (uint32_t i = 0; i < interleave; ++i) {
+		lists.emplace_back(new list_type(pool));
+	}
+
+	// Descending keys keep every insert at the front
+	for (uint32_t i = length; i != 0; --i) {
+		for (std::unique_ptr<list_type>& list : lists) {
+			list->unsafe_insert({ i, i });
+		}
+	}
+
+	list_type& list(*lists[0]);
+
+	const std::chrono::high_resolution_clock::time_point start(std::chrono::high_resolution_clock::now());
+	for (uint32_t i = 0; i < inserts; ++i) {
+		list.insert({ length + 1 + i, i });
+	}
+	const std::chrono::duration<double, std::nano> elapsed(std::chrono::high_resolution_clock::now() - start);
+
+	return elapsed.count() / (static_cast<double>(length) * inserts);
 }
 
+// Every thread inserts random keys into one shared list
+template <class Traits>
+double random_inserts()
+{
+	gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, Traits> list;
+
+	return run_threads([&list](uint32_t threadIndex) {
+		std::default_random_engine rng(threadIndex);
+		std::uniform_int_distribution<uint64_t> dist;
+		for (uint32_t i = 0; i < Ops_Per_Thread / 16; ++i) {
+			const uint64_t key(dist(rng));
+			list.insert({ key, key });
+		}
+	}) * 16;
+}
+
+// As random_inserts, spread over range partitioned shards
+double random_inserts_partitioned()
+{
+	gdul::range_partitioned_sorted_list<uint64_t, uint64_t> list(0, std::numeric_limits<uint64_t>::max());
+
+	return run_threads([&list](uint32_t threadIndex) {
+		std::default_random_engine rng(threadIndex);
+		std::uniform_int_distribution<uint64_t> dist;
+		for (uint32_t i = 0; i < Ops_Per_Thread / 16; ++i) {
+			const uint64_t key(dist(rng));
+			list.insert({ key, key });
+		}
+	}) * 16;
+}
+
+// Every thread inserts ascending keys of its own, as timestamped producers 
+// would, then pops as many
+double monotonic_producers_list()
+{
+	gdul::concurrent_sorted_list<uint64_t, uint64_t> list;
+
+	return run_threads([&list](uint32_t threadIndex) {
+		std::pair<uint64_t, uint64_t> out;
+		for (uint32_t i = 0; i < Ops_Per_Thread / 16; ++i) {
+			list.insert({ i * Num_Threads + threadIndex, i });
+		}
+		for (uint32_t i = 0; i < Ops_Per_Thread / 16; ++i) {
+			list.try_pop(out);
+		}
+	}) * 8;
+}
+
+// The same work as monotonic_producers_list, on a tournament_queue
+double monotonic_producers_tournament_queue()
+{
+	gdul::tournament_queue<uint64_t, uint64_t> queue;
+
+	return run_threads([&queue](uint32_t threadIndex) {
+		std::pair<uint64_t, uint64_t> out;
+		for (uint32_t i = 0; i < Ops_Per_Thread / 16; ++i) {
+			queue.push({ i * Num_Threads + threadIndex, i });
+		}
+		for (uint32_t i = 0; i < Ops_Per_Thread / 16; ++i) {
+			queue.try_pop(out);
+		}
+	}) * 8;
+}
+
+// Every thread inserts over 16 priority levels, then pops as many
+double priority_levels_list()
+{
+	gdul::concurrent_sorted_list<uint8_t, uint64_t> list;
+
+	return run_threads([&list](uint32_t) {
+		std::pair<uint8_t, uint64_t> out;
+		for (uint32_t i = 0; i < Ops_Per_Thread / 16; ++i) {
+			list.insert({ static_cast<uint8_t>(i % 16), i });
+		}
+		for (uint32_t i = 0; i < Ops_Per_Thread / 16; ++i) {
+			list.try_pop(out);
+		}
+	}) * 8;
+}
+
+// The same work as priority_levels_list, on a bitmap_priority_queue
+double priority_levels_bitmap_queue()
+{
+	gdul::bitmap_priority_queue<uint8_t, uint64_t> queue;
+
+	return run_threads([&queue](uint32_t) {
+		std::pair<uint8_t, uint64_t> out;
+		for (uint32_t i = 0; i < Ops_Per_Thread / 16; ++i) {
+			queue.insert({ static_cast<uint8_t>(i % 16), i });
+		}
+		for (uint32_t i = 0; i < Ops_Per_Thread / 16; ++i) {
+			queue.try_pop(out);
+		}
+	}) * 8;
+}
+
+// The hold model of event simulation. Every pop schedules a new event a 
+// random gap after the one popped
+template <class Queue>
+double hold_model()
+{
+	Queue queue;
+
+	std::default_random_engine seed(0);
+	std::uniform_real_distribution<double> start(0.0, 1024.0);
+	for (uint32_t i = 0; i < 1024; ++i) {
+		queue.insert({ start(seed), i });
+	}
+
+	return run_threads([&queue](uint32_t threadIndex) {
+		std::default_random_engine rng(threadIndex);
+		std::exponential_distribution<double> gap(1.0);
+		std::pair<double, uint32_t> out;
+		for (uint32_t i = 0; i < Ops_Per_Thread / 16; ++i) {
+			if (queue.try_pop(out)) {
+				queue.insert({ out.first + gap(rng), i });
+			}
+		}
+	}) * 8;
+}
+}
+
+int main()
+{
+	std::cout << "sizeof list, 64 byte padding: " << sizeof(gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, padding_64_traits>) << std::endl;
+	std::cout << "sizeof list, 128 byte padding: " << sizeof(gdul::concurrent_sorted_list<uint64_t, uint64_t, gdul::csldetail::tiny_less, padding_128_traits>) << std::endl;
+
+	std::cout << "shared list, 64 byte padding: " << shared_list<padding_64_traits>() << " ns/op" << std::endl;
+	std::cout << "shared list, 128 byte padding: " << shared_list<padding_128_traits>() << " ns/op" << std::endl;
+	std::cout << "shared list, sharded size: " << shared_list<sharded_size_traits>() << " ns/op" << std::endl;
+	std::cout << "shared list, quantile sketch: " << shared_list<quantile_traits>() << " ns/op" << std::endl;
+	std::cout << "adjacent lists, 64 byte padding: " << adjacent_lists<padding_64_traits>() << " ns/op" << std::endl;
+	std::cout << "adjacent lists, 128 byte padding: " << adjacent_lists<padding_128_traits>() << " ns/op" << std::endl;
+
+	std::cout << "pop, one thread: " << drain<gdul::csl_default_traits>() << " ns/op" << std::endl;
+	std::cout << "pop, one thread, single consumer: " << drain<gdul::csl_single_consumer_traits>() << " ns/op" << std::endl;
+	std::cout << "pop, all threads, unlink per pop: " << drain_concurrent<gdul::csl_default_traits>() << " ns/op" << std::endl;
+	std::cout << "pop, all threads, batched unlinking: " << drain_concurrent<pop_batch_traits>() << " ns/op" << std::endl;
+	std::cout << "pop, all threads, chunked priority queue: " << drain_concurrent_chunked() << " ns/op" << std::endl;
+
+	std::cout << "exclusive build and drain, list: " << exclusive_phase_list<gdul::csl_default_traits>() << " ns/entry" << std::endl;
+	std::cout << "exclusive build and drain, list with std::allocator: " << exclusive_phase_list<std_allocator_traits>() << " ns/entry" << std::endl;
+	std::cout << "exclusive build and drain, std::multimap: " << exclusive_phase_multimap() << " ns/entry" << std::endl;
+
+	// Roughly 100 bytes per node, times 64 interleaved lists
+	std::cout << "traversal within LLC, no prefetch: " << traversal<gdul::csl_default_traits>(256) << " ns/node" << std::endl;
+	std::cout << "traversal within LLC, prefetch distance 1: " << traversal<prefetch_1_traits>(256) << " ns/node" << std::endl;
+	std::cout << "traversal within LLC, prefetch distance 2: " << traversal<prefetch_2_traits>(256) << " ns/node" << std::endl;
+	std::cout << "traversal beyond LLC, no prefetch: " << traversal<gdul::csl_default_traits>(16384) << " ns/node" << std::endl;
+	std::cout << "traversal beyond LLC, prefetch distance 1: " << traversal<prefetch_1_traits>(16384) << " ns/node" << std::endl;
+	std::cout << "traversal beyond LLC, prefetch distance 2: " << traversal<prefetch_2_traits>(16384) << " ns/node" << std::endl;
+
+	std::cout << "random inserts, no index: " << random_inserts<gdul::csl_default_traits>() << " ns/op" << std::endl;
+	std::cout << "random inserts, jump index: " << random_inserts<jump_index_traits>() << " ns/op" << std::endl;
+	std::cout << "random inserts, adaptive index: " << random_inserts<gdul::csl_adaptive_traits>() << " ns/op" << std::endl;
+	std::cout << "random inserts, 8 range partitioned shards: " << random_inserts_partitioned() << " ns/op" << std::endl;
+
+	std::cout << "monotonic producers, list: " << monotonic_producers_list() << " ns/op" << std::endl;
+	std::cout << "monotonic producers, tournament queue: " << monotonic_producers_tournament_queue() << " ns/op" << std::endl;
+	std::cout << "priority levels, list: " << priority_levels_list() << " ns/op" << std::endl;
+	std::cout << "priority levels, bitmap priority queue: " << priority_levels_bitmap_queue() << " ns/op" << std::endl;
+
+	std::cout << "hold model, list: " << hold_model<gdul::concurrent_sorted_list<double, uint32_t>>() << " ns/op" << std::endl;
+	std::cout << "hold model, calendar queue: " << hold_model<gdul::concurrent_calendar_queue<double, uint32_t>>() << " ns/op" << std::endl;
+	std::cout << "hold model, chunked priority queue: " << hold_model<gdul::chunked_priority_queue<double, uint32_t>>() << " ns/op" << std::endl;
+}
@@ -0,0 +1,385 @@
+// Copyright(c) 2019 Flovin Michaelsen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <gdul\concurrent_queue.h>
+#include "concurrent_sorted_list.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace gdul
+{
+namespace csldetail
+{
+// Index of the lowest set bit. Undefined for zero
+inline const std::size_t lowest_set_bit(std::uint64_t bits);
+}
+
+// A priority queue for unsigned key types of at most 16 bits, such as 
+// priority levels. Each key owns a concurrent_queue and an entry count, 
+// created on first use, and a bit in a two level occupancy bitmap. Slots for
+// the levels are themselves created on first use, 64 keys at a time. The lowest
+// occupied key is found by scanning the summary words, then the one occupancy
+// word they point out. Inserts and pops are constant time, and entries of the
+// same key pop in the order each producer inserted them. 
+// Each level queue takes an object id from concurrent_queue, so threads keep 
+// slot vectors sized by the number of levels ever used
+template <class KeyType, class ValueType>
+class bitmap_priority_queue
+{
+public:
+	typedef std::size_t size_type;
+	typedef KeyType key_type;
+	typedef ValueType value_type;
+
+	static_assert(std::is_integral<KeyType>::value && std::is_unsigned<KeyType>::value && !(2 < sizeof(KeyType)), "bitmap_priority_queue needs an unsigned key type of at most 16 bits");
+
+	bitmap_priority_queue();
+	~bitmap_priority_queue();
+
+	void insert(const std::pair<key_type, value_type>& in);
+	void insert(std::pair<key_type, value_type>&& in);
+
+	const bool try_pop(value_type& out);
+	const bool try_pop(std::pair<key_type, value_type>& out);
+
+	// Top key hint
+	const bool try_peek_top_key(key_type& out) const;
+
+	// Approximate while in use
+	const size_type size() const;
+
+	void unsafe_clear();
+
+private:
+	static constexpr std::size_t Cache_Line_Size = CSL_CACHE_LINE_SIZE;
+	static constexpr std::size_t Levels = static_cast<std::size_t>(std::numeric_limits<key_type>::max()) + 1;
+	static constexpr std::size_t Words = (Levels + 63) / 64;
+	static constexpr std::size_t Summary_Words = (Words + 63) / 64;
+
+	struct level
+	{
+		level();
+
+		// Returns false if there was nothing to reserve
+		const bool try_reserve();
+
+		concurrent_queue<value_type> myQueue;
+
+		// Raised after each push, and reserved from before each pop, since 
+		// the queue may fail to pop while another consumer is mid pop
+		std::atomic<std::size_t> myEntries;
+		CSL_PADD(Cache_Line_Size - (sizeof(std::atomic<std::size_t>) % Cache_Line_Size));
+	};
+
+	// The level slots of the keys in one occupancy word
+	struct level_block
+	{
+		level_block();
+		~level_block();
+
+		std::atomic<level*> myLevels[64];
+	};
+
+	level& level_of(key_type key);
+
+	// Null unless created
+	level* find_level(std::size_t index) const;
+
+	// Returns false if no level is occupied
+	const bool try_find_lowest(std::size_t& out) const;
+
+	void mark_occupied(std::size_t index);
+	void mark_vacant(std::size_t index);
+
+	std::atomic<std::uint64_t> mySummary[Summary_Words];
+	CSL_PADD(Cache_Line_Size - (sizeof(std::atomic<std::uint64_t>) * Summary_Words % Cache_Line_Size));
+	std::atomic<std::uint64_t> myOccupied[Words];
+	CSL_PADD(Cache_Line_Size - (sizeof(std::atomic<std::uint64_t>) * Words % Cache_Line_Size));
+
+	csl_sharded_size<16, Cache_Line_Size> mySize;
+
+	const std::unique_ptr<std::atomic<level_block*>[]> myBlocks;
+};
+
+template <class KeyType, class ValueType>
+inline bitmap_priority_queue<KeyType, ValueType>::bitmap_priority_queue()
+	: myBlocks(new std::atomic<level_block*>[Words])
+{
+	for (std::size_t i = 0; i < Words; ++i) {
+		myBlocks[i].store(nullptr, std::memory_order_relaxed);
+	}
+	for (std::atomic<std::uint64_t>& word : mySummary) {
+		word.store(0, std::memory_order_relaxed);
+	}
+	for (std::atomic<std::uint64_t>& word : myOccupied) {
+		word.store(0, std::memory_order_relaxed);
+	}
+}
+template <class KeyType, class ValueType>
+inline bitmap_priority_queue<KeyType, ValueType>::~bitmap_priority_queue()
+{
+	for (std::size_t i = 0; i < Words; ++i) {
+		delete myBlocks[i].load(std::memory_order_relaxed);
+	}
+}
+template <class KeyType, class ValueType>
+inline void bitmap_priority_queue<KeyType, ValueType>::insert(const std::pair<key_type, value_type>& in)
+{
+	level& to(level_of(in.first));
+	to.myQueue.push(in.second);
+	to.myEntries.fetch_add(1, std::memory_order_seq_cst);
+
+	mySize.add(1);
+	mark_occupied(static_cast<std::size_t>(in.first));
+}
+template <class KeyType, class ValueType>
+inline void bitmap_priority_queue<KeyType, ValueType>::insert(std::pair<key_type, value_type>&& in)
+{
+	level& to(level_of(in.first));
+	to.myQueue.push(std::move(in.second));
+	to.myEntries.fetch_add(1, std::memory_order_seq_cst);
+
+	mySize.add(1);
+	mark_occupied(static_cast<std::size_t>(in.first));
+}
+template <class KeyType, class ValueType>
+inline const bool bitmap_priority_queue<KeyType, ValueType>::try_pop(value_type & out)
+{
+	std::pair<key_type, value_type> pair;
+	if (!try_pop(pair)) {
+		return false;
+	}
+	out = std::move(pair.second);
+	return true;
+}
+template <class KeyType, class ValueType>
+inline const bool bitmap_priority_queue<KeyType, ValueType>::try_pop(std::pair<key_type, value_type>& out)
+{
+	for (std::size_t index(0); try_find_lowest(index);) {
+		level* const from(find_level(index));
+
+		if (!from->try_reserve()) {
+			mark_vacant(index);
+
+			// An insert may have landed between the reservation failing and 
+			// the bit being cleared, without seeing the bit to need setting
+			if (from->myEntries.load(std::memory_order_seq_cst)) {
+				mark_occupied(index);
+			}
+			continue;
+		}
+
+		// The reserved entry is there, though the queue may not yield it at once
+		while (!from->myQueue.try_pop(out.second)) {
+			std::this_thread::yield();
+		}
+
+		out.first = static_cast<key_type>(index);
+		mySize.add(-1);
+
+		return true;
+	}
+	return false;
+}
+template <class KeyType, class ValueType>
+inline const bool bitmap_priority_queue<KeyType, ValueType>::try_peek_top_key(key_type & out) const
+{
+	std::size_t index(0);
+	if (!try_find_lowest(index)) {
+		return false;
+	}
+	out = static_cast<key_type>(index);
+	return true;
+}
+template <class KeyType, class ValueType>
+inline const typename bitmap_priority_queue<KeyType, ValueType>::size_type bitmap_priority_queue<KeyType, ValueType>::size() const
+{
+	return mySize.load();
+}
+template <class KeyType, class ValueType>
+inline void bitmap_priority_queue<KeyType, ValueType>::unsafe_clear()
+{
+	for (std::size_t i = 0; i < Levels; ++i) {
+		level* const at(find_level(i));
+		if (at) {
+			at->myQueue.unsafe_clear();
+			at->myEntries.store(0, std::memory_order_relaxed);
+		}
+	}
+	for (std::atomic<std::uint64_t>& word : mySummary) {
+		word.store(0, std::memory_order_relaxed);
+	}
+	for (std::atomic<std::uint64_t>& word : myOccupied) {
+		word.store(0, std::memory_order_relaxed);
+	}
+	mySize.unsafe_reset();
+}
+template <class KeyType, class ValueType>
+inline typename bitmap_priority_queue<KeyType, ValueType>::level & bitmap_priority_queue<KeyType, ValueType>::level_of(key_type key)
+{
+	std::atomic<level_block*>& blockSlot(myBlocks[static_cast<std::size_t>(key) / 64]);
+
+	level_block* block(blockSlot.load(std::memory_order_acquire));
+	if (!block) {
+		level_block* const created(new level_block());
+		if (blockSlot.compare_exchange_strong(block, created, std::memory_order_acq_rel, std::memory_order_acquire)) {
+			block = created;
+		}
+		else {
+			delete created;
+		}
+	}
+
+	std::atomic<level*>& slot(block->myLevels[static_cast<std::size_t>(key) % 64]);
+
+	level* existing(slot.load(std::memory_order_acquire));
+	if (existing) {
+		return *existing;
+	}
+
+	level* const created(new level());
+	if (slot.compare_exchange_strong(existing, created, std::memory_order_acq_rel, std::memory_order_acquire)) {
+		return *created;
+	}
+	delete created;
+
+	return *existing;
+}
+template <class KeyType, class ValueType>
+inline typename bitmap_priority_queue<KeyType, ValueType>::level * bitmap_priority_queue<KeyType, ValueType>::find_level(std::size_t index) const
+{
+	level_block* const block(myBlocks[index / 64].load(std::memory_order_acquire));
+	if (!block) {
+		return nullptr;
+	}
+	return block->myLevels[index % 64].load(std::memory_order_acquire);
+}
+template <class KeyType, class ValueType>
+inline const bool bitmap_priority_queue<KeyType, ValueType>::try_find_lowest(std::size_t & out) const
+{
+	for (std::size_t i = 0; i < Summary_Words; ++i) {
+		for (std::uint64_t summary(mySummary[i].load(std::memory_order_seq_cst)); summary; summary &= summary - 1) {
+			const std::size_t word(i * 64 + csldetail::lowest_set_bit(summary));
+			const std::uint64_t occupied(myOccupied[word].load(std::memory_order_seq_cst));
+
+			// The summary bit may linger a moment after the word emptied
+			if (occupied) {
+				out = word * 64 + csldetail::lowest_set_bit(occupied);
+				return true;
+			}
+		}
+	}
+	return false;
+}
+template <class KeyType, class ValueType>
+inline void bitmap_priority_queue<KeyType, ValueType>::mark_occupied(std::size_t index)
+{
+	const std::size_t word(index / 64);
+	const std::uint64_t bit(std::uint64_t(1) << (index % 64));
+	const std::uint64_t summaryBit(std::uint64_t(1) << (word % 64));
+
+	// Pairs with the popper clearing the bit, then reloading the entry count.
+	// One of the two is sure to see the other
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	// Hot levels stay marked, so avoid writing to the shared lines
+	if (!(myOccupied[word].load(std::memory_order_seq_cst) & bit)) {
+		myOccupied[word].fetch_or(bit, std::memory_order_seq_cst);
+	}
+	if (!(mySummary[word / 64].load(std::memory_order_seq_cst) & summaryBit)) {
+		mySummary[word / 64].fetch_or(summaryBit, std::memory_order_seq_cst);
+	}
+}
+template <class KeyType, class ValueType>
+inline void bitmap_priority_queue<KeyType, ValueType>::mark_vacant(std::size_t index)
+{
+	const std::size_t word(index / 64);
+	const std::uint64_t bit(std::uint64_t(1) << (index % 64));
+	const std::uint64_t summaryBit(std::uint64_t(1) << (word % 64));
+
+	const std::uint64_t occupied(myOccupied[word].fetch_and(~bit, std::memory_order_seq_cst));
+
+	if (occupied == bit) {
+		mySummary[word / 64].fetch_and(~summaryBit, std::memory_order_seq_cst);
+
+		// Levels marked since are owed their summary bit back
+		if (myOccupied[word].load(std::memory_order_seq_cst)) {
+			mySummary[word / 64].fetch_or(summaryBit, std::memory_order_seq_cst);
+		}
+	}
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+template <class KeyType, class ValueType>
+inline bitmap_priority_queue<KeyType, ValueType>::level::level()
+	: myEntries(0)
+{
+}
+template <class KeyType, class ValueType>
+inline bitmap_priority_queue<KeyType, ValueType>::level_block::level_block()
+{
+	for (std::atomic<level*>& slot : myLevels) {
+		slot.store(nullptr, std::memory_order_relaxed);
+	}
+}
+template <class KeyType, class ValueType>
+inline bitmap_priority_queue<KeyType, ValueType>::level_block::~level_block()
+{
+	for (std::atomic<level*>& slot : myLevels) {
+		delete slot.load(std::memory_order_relaxed);
+	}
+}
+template <class KeyType, class ValueType>
+inline const bool bitmap_priority_queue<KeyType, ValueType>::level::try_reserve()
+{
+	std::size_t entries(myEntries.load(std::memory_order_relaxed));
+	do {
+		if (!entries) {
+			return false;
+		}
+	} while (!myEntries.compare_exchange_weak(entries, entries - 1, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+	return true;
+}
+
+namespace csldetail
+{
+inline const std::size_t lowest_set_bit(std::uint64_t bits)
+{
+#ifdef _MSC_VER
+	unsigned long index(0);
+	_BitScanForward64(&index, bits);
+	return static_cast<std::size_t>(index);
+#else
+	return static_cast<std::size_t>(__builtin_ctzll(bits));
+#endif
+}
+}
+}
@@ -0,0 +1,566 @@
+// Copyright(c) 2019 Flovin Michaelsen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "concurrent_sorted_list.h"
+#include "shard_gate.h"
+
+namespace gdul
+{
+namespace csldetail
+{
+template <class KeyType, class ValueType>
+class append_chunk;
+
+enum class refill_result : uint8_t
+{
+	// Another thread was restructuring
+	Retry,
+	Refilled,
+	Empty
+};
+}
+
+// A chunk based priority queue after Braginsky, Cohen and Petrank (CBPQ).
+// Entries are kept in chunks covering consecutive key ranges. The first
+// chunk is sorted and never written to, so that pops claim its entries with a
+// fetch_add on an index. Later chunks take inserts by a fetch_add on their
+// length, unsorted. Inserts keyed within the first chunk's range go to a
+// buffer chunk. Pops merge it into a new first chunk only once it holds a 
+// key ahead of the next one to pop, or the first chunk runs out.
+//
+// Unlike CBPQ, chunks are not frozen one by one. Every insert and pop passes
+// a striped gate, and chunks are sorted, split and merged with the queue 
+// briefly closed instead. Pops thus pay for entering and leaving the gate on 
+// top of the fetch_add, and all operations wait out a restructuring. 
+// Restructuring is rare: once a chunk fills, the first chunk runs out or a 
+// buffered key comes first
+template <class KeyType, class ValueType, class Comparator = csldetail::tiny_less, std::size_t ChunkCapacity = 512>
+class chunked_priority_queue
+{
+public:
+	typedef std::size_t size_type;
+	typedef KeyType key_type;
+	typedef ValueType value_type;
+	typedef Comparator comparator_type;
+
+	static_assert(std::is_integral<key_type>::value || std::is_floating_point<key_type>::value, "Only integers and floats allowed as key type");
+	static_assert(1 < ChunkCapacity, "chunked_priority_queue needs chunks of at least two entries");
+
+	chunked_priority_queue();
+
+	void insert(const std::pair<key_type, value_type>& in);
+	void insert(std::pair<key_type, value_type>&& in);
+
+	const bool try_pop(value_type& out);
+	const bool try_pop(std::pair<key_type, value_type>& out);
+
+	// Top key hint
+	const bool try_peek_top_key(key_type& out);
+
+	// Approximate while in use
+	const size_type size() const;
+
+	void unsafe_clear();
+
+	// Number of chunks after the first. Not to be read while the queue is in use
+	const std::size_t unsafe_chunk_count() const;
+
+private:
+	typedef std::pair<key_type, value_type> entry_type;
+	typedef csldetail::append_chunk<key_type, value_type> chunk_type;
+
+	static constexpr std::size_t Cache_Line_Size = CSL_CACHE_LINE_SIZE;
+
+	// The chunk taking key, the buffer for keys within the first chunk's range.
+	// Called inside the gate
+	chunk_type& route(const key_type& key);
+
+	// Whether the first chunk must be refilled before popping. Called inside the gate
+	const bool first_stale() const;
+
+	// Lowers myBufferMin to key. Called inside the gate
+	void buffered(const key_type& key);
+
+	// Appends in to the chunk taking its key. Fails, leaving in untouched, 
+	// if that chunk is full. Called inside the gate
+	const bool try_append_routed(entry_type& in);
+
+	// Called outside the gate
+	const csldetail::refill_result refill_first();
+	void split_full(const key_type& key);
+
+	// Called with the gate closed
+	void absorb_next(std::vector<entry_type>& into);
+	void sort_entries(std::vector<entry_type>& entries) const;
+
+	// Entered by inserts and pops, closed while restructuring chunks
+	csldetail::shard_gate<16, Cache_Line_Size> myGate;
+
+	std::atomic<size_type> myPopped;
+	CSL_PADD(Cache_Line_Size - (sizeof(std::atomic<size_type>) % Cache_Line_Size));
+
+	csl_sharded_size<16, Cache_Line_Size> mySize;
+
+	// Changed with the gate closed only
+	std::vector<entry_type> myFirst;
+	key_type myFirstMax;
+	bool myFirstCovers;
+
+	std::unique_ptr<chunk_type> myBuffer;
+
+	// Lowest key in the buffer, or myFirstMax while empty
+	std::atomic<key_type> myBufferMin;
+
+	// By ascending range. The last is unbounded
+	std::vector<std::unique_ptr<chunk_type>> myChunks;
+
+	comparator_type myComparator;
+};
+
+namespace csldetail
+{
+// Entries in insertion order, appended to by a fetch_add on the length.
+// Read only with the owning queue closed, once all appends are done
+template <class KeyType, class ValueType>
+class append_chunk
+{
+public:
+	typedef std::pair<KeyType, ValueType> entry_type;
+
+	append_chunk(std::size_t capacity, bool bounded, const KeyType& max);
+	~append_chunk();
+
+	// Fails once full, leaving in untouched
+	const bool try_append(entry_type& in);
+
+	const bool empty() const;
+	const bool full() const;
+
+	// Moves all entries out, leaving the chunk empty
+	void take(std::vector<entry_type>& into);
+
+	const std::size_t myCapacity;
+	const KeyType myMax;
+	const bool myBounded;
+
+private:
+	const std::size_t length() const;
+
+	std::atomic<std::size_t> myAppended;
+	std::unique_ptr<typename std::aligned_storage<sizeof(entry_type), alignof(entry_type)>::type[]> myEntries;
+};
+}
+
+template <class KeyType, class ValueType, class Comparator, std::size_t ChunkCapacity>
+inline chunked_priority_queue<KeyType, ValueType, Comparator, ChunkCapacity>::chunked_priority_queue()
+	: myPopped(0)
+	, myFirstMax(0)
+	, myFirstCovers(false)
+	, myBuffer(new chunk_type(ChunkCapacity, true, key_type(0)))
+	, myBufferMin(key_type(0))
+{
+	myChunks.emplace_back(new chunk_type(ChunkCapacity, false, key_type(0)));
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t ChunkCapacity>
+inline void chunked_priority_queue<KeyType, ValueType, Comparator, ChunkCapacity>::insert(const std::pair<key_type, value_type>& in)
+{
+	insert(std::pair<key_type, value_type>(in));
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t ChunkCapacity>
+inline void chunked_priority_queue<KeyType, ValueType, Comparator, ChunkCapacity>::insert(std::pair<key_type, value_type>&& in)
+{
+	for (;;) {
+		const std::size_t stripe(myGate.enter());
+
+		const bool appended(try_append_routed(in));
+		if (appended) {
+			mySize.add(1);
+		}
+
+		myGate.leave(stripe);
+
+		if (appended) {
+			return;
+		}
+
+		split_full(in.first);
+	}
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t ChunkCapacity>
+inline const bool chunked_priority_queue<KeyType, ValueType, Comparator, ChunkCapacity>::try_pop(value_type & out)
+{
+	std::pair<key_type, value_type> pair;
+	if (!try_pop(pair)) {
+		return false;
+	}
+	out = std::move(pair.second);
+	return true;
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t ChunkCapacity>
+inline const bool chunked_priority_queue<KeyType, ValueType, Comparator, ChunkCapacity>::try_pop(std::pair<key_type, value_type>& out)
+{
+	for (;;) {
+		const std::size_t stripe(myGate.enter());
+
+		bool popped(false);
+		bool displaced(false);
+
+		const size_type index(myPopped.fetch_add(1, std::memory_order_relaxed));
+		if (index < myFirst.size()) {
+			out = std::move(myFirst[index]);
+
+			// A key buffered since comes first. The claimed entry goes back in 
+			// before leaving, so that no refill runs without it
+			displaced = myComparator(myBufferMin.load(std::memory_order_acquire), out.first);
+			popped = !displaced;
+
+			if (displaced) {
+				displaced = !try_append_routed(out);
+			}
+		}
+
+		myGate.leave(stripe);
+
+		if (popped) {
+			mySize.add(-1);
+			return true;
+		}
+
+		// Its chunk was full
+		if (displaced) {
+			insert(std::move(out));
+			mySize.add(-1);
+		}
+		if (refill_first() == csldetail::refill_result::Empty) {
+			return false;
+		}
+	}
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t ChunkCapacity>
+inline const bool chunked_priority_queue<KeyType, ValueType, Comparator, ChunkCapacity>::try_peek_top_key(key_type & out)
+{
+	for (;;) {
+		const std::size_t stripe(myGate.enter());
+
+		bool found(false);
+
+		const size_type index(myPopped.load(std::memory_order_relaxed));
+		if (index < myFirst.size()) {
+			const key_type bufferMin(myBufferMin.load(std::memory_order_acquire));
+			out = myComparator(bufferMin, myFirst[index].first) ? bufferMin : myFirst[index].first;
+			found = true;
+		}
+
+		myGate.leave(stripe);
+
+		if (found) {
+			return true;
+		}
+		if (refill_first() == csldetail::refill_result::Empty) {
+			return false;
+		}
+	}
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t ChunkCapacity>
+inline const typename chunked_priority_queue<KeyType, ValueType, Comparator, ChunkCapacity>::size_type chunked_priority_queue<KeyType, ValueType, Comparator, ChunkCapacity>::size() const
+{
+	return mySize.load();
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t ChunkCapacity>
+inline void chunked_priority_queue<KeyType, ValueType, Comparator, ChunkCapacity>::unsafe_clear()
+{
+	myFirst.clear();
+	myPopped.store(0, std::memory_order_relaxed);
+	myFirstMax = key_type(0);
+	myFirstCovers = false;
+	myBufferMin.store(key_type(0), std::memory_order_relaxed);
+
+	myBuffer.reset(new chunk_type(ChunkCapacity, true, key_type(0)));
+
+	myChunks.clear();
+	myChunks.emplace_back(new chunk_type(ChunkCapacity, false, key_type(0)));
+
+	mySize.unsafe_reset();
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t ChunkCapacity>
+inline const std::size_t chunked_priority_queue<KeyType, ValueType, Comparator, ChunkCapacity>::unsafe_chunk_count() const
+{
+	return myChunks.size();
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t ChunkCapacity>
+inline typename chunked_priority_queue<KeyType, ValueType, Comparator, ChunkCapacity>::chunk_type & chunked_priority_queue<KeyType, ValueType, Comparator, ChunkCapacity>::route(const key_type & key)
+{
+	if (myFirstCovers && !myComparator(myFirstMax, key)) {
+		return *myBuffer;
+	}
+
+	const comparator_type& comparator(myComparator);
+	const typename std::vector<std::unique_ptr<chunk_type>>::iterator it(std::lower_bound(myChunks.begin(), myChunks.end() - 1, key, [&comparator](const std::unique_ptr<chunk_type>& chunk, const key_type& key) {
+		return comparator(chunk->myMax, key);
+	}));
+
+	return **it;
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t ChunkCapacity>
+inline const bool chunked_priority_queue<KeyType, ValueType, Comparator, ChunkCapacity>::first_stale() const
+{
+	const size_type popped(myPopped.load(std::memory_order_relaxed));
+	if (!(popped < myFirst.size())) {
+		return true;
+	}
+
+	// Buffered keys up to the next one to pop may wait
+	return myComparator(myBufferMin.load(std::memory_order_relaxed), myFirst[popped].first);
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t ChunkCapacity>
+inline void chunked_priority_queue<KeyType, ValueType, Comparator, ChunkCapacity>::buffered(const key_type & key)
+{
+	key_type expected(myBufferMin.load(std::memory_order_relaxed));
+	while (myComparator(key, expected) && !myBufferMin.compare_exchange_weak(expected, key, std::memory_order_release, std::memory_order_relaxed));
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t ChunkCapacity>
+inline const bool chunked_priority_queue<KeyType, ValueType, Comparator, ChunkCapacity>::try_append_routed(entry_type & in)
+{
+	const key_type key(in.first);
+	chunk_type& chunk(route(key));
+
+	if (!chunk.try_append(in)) {
+		return false;
+	}
+	if (&chunk == myBuffer.get()) {
+		buffered(key);
+	}
+	return true;
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t ChunkCapacity>
+inline const csldetail::refill_result chunked_priority_queue<KeyType, ValueType, Comparator, ChunkCapacity>::refill_first()
+{
+	// Restructured by another thread meanwhile. Entering the gate waits it out
+	if (!myGate.try_close()) {
+		return csldetail::refill_result::Retry;
+	}
+
+	// Already refilled by whoever closed the queue before
+	if (!first_stale()) {
+		myGate.open();
+		return csldetail::refill_result::Refilled;
+	}
+
+	const size_type popped((std::min)(myPopped.load(std::memory_order_relaxed), myFirst.size()));
+
+	std::vector<entry_type> entries(std::make_move_iterator(myFirst.begin() + popped), std::make_move_iterator(myFirst.end()));
+	myBuffer->take(entries);
+
+	if (entries.empty()) {
+		absorb_next(entries);
+	}
+	sort_entries(entries);
+
+	myFirst = std::move(entries);
+	myPopped.store(0, std::memory_order_relaxed);
+	myBufferMin.store(myFirstMax, std::memory_order_relaxed);
+
+	const bool found(!myFirst.empty());
+
+	myGate.open();
+
+	return found ? csldetail::refill_result::Refilled : csldetail::refill_result::Empty;
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t ChunkCapacity>
+inline void chunked_priority_queue<KeyType, ValueType, Comparator, ChunkCapacity>::split_full(const key_type & key)
+{
+	if (!myGate.try_close()) {
+		std::this_thread::yield();
+		return;
+	}
+
+	chunk_type& full(route(key));
+
+	// Already dealt with by whoever closed the queue before
+	if (!full.full()) {
+		myGate.open();
+		return;
+	}
+
+	// The buffer empties into the first chunk
+	if (&full == myBuffer.get()) {
+		const size_type popped((std::min)(myPopped.load(std::memory_order_relaxed), myFirst.size()));
+
+		std::vector<entry_type> entries(std::make_move_iterator(myFirst.begin() + popped), std::make_move_iterator(myFirst.end()));
+		myBuffer->take(entries);
+		sort_entries(entries);
+
+		myFirst = std::move(entries);
+		myPopped.store(0, std::memory_order_relaxed);
+		myBufferMin.store(myFirstMax, std::memory_order_relaxed);
+
+		myGate.open();
+		return;
+	}
+
+	const std::size_t index(static_cast<std::size_t>(std::find_if(myChunks.begin(), myChunks.end(), [&full](const std::unique_ptr<chunk_type>& chunk) { return chunk.get() == &full; }) - myChunks.begin()));
+
+	std::vector<entry_type> entries;
+	full.take(entries);
+	sort_entries(entries);
+
+	// Halves at the median key, though equal keys may leave one half empty.
+	// A chunk of equal keys grows instead
+	const key_type median(entries[entries.size() / 2 - 1].first);
+	const comparator_type& comparator(myComparator);
+	const typename std::vector<entry_type>::iterator upper(std::upper_bound(entries.begin(), entries.end(), median, [&comparator](const key_type& key, const entry_type& entry) {
+		return comparator(key, entry.first);
+	}));
+
+	const std::size_t lowerCount(static_cast<std::size_t>(upper - entries.begin()));
+	const std::size_t upperCount(entries.size() - lowerCount);
+
+	std::unique_ptr<chunk_type> lower(new chunk_type((std::max)(ChunkCapacity, lowerCount * 2), true, median));
+	std::unique_ptr<chunk_type> higher(new chunk_type((std::max)(ChunkCapacity, upperCount * 2), full.myBounded, full.myMax));
+
+	for (std::size_t i = 0; i < entries.size(); ++i) {
+		(i < lowerCount ? lower : higher)->try_append(entries[i]);
+	}
+
+	myChunks[index] = std::move(higher);
+	myChunks.insert(myChunks.begin() + index, std::move(lower));
+
+	myGate.open();
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t ChunkCapacity>
+inline void chunked_priority_queue<KeyType, ValueType, Comparator, ChunkCapacity>::absorb_next(std::vector<entry_type>& into)
+{
+	// Chunks only ever empty by being absorbed, save for the unbounded last
+	while (into.empty() && !(myChunks.size() == 1 && myChunks.front()->empty())) {
+		std::unique_ptr<chunk_type>& next(myChunks.front());
+
+		if (next->myBounded) {
+			next->take(into);
+			myFirstMax = next->myMax;
+			myFirstCovers = true;
+			myChunks.erase(myChunks.begin());
+			continue;
+		}
+
+		// The unbounded last chunk hands over its lower half only, so that
+		// the first chunk does not come to cover every key
+		std::vector<entry_type> entries;
+		next->take(entries);
+		sort_entries(entries);
+
+		const std::size_t half((entries.size() + 1) / 2);
+		myFirstMax = entries[half - 1].first;
+		myFirstCovers = true;
+
+		std::size_t taken(half);
+		while (taken < entries.size() && !myComparator(myFirstMax, entries[taken].first)) {
+			++taken;
+		}
+
+		into.assign(std::make_move_iterator(entries.begin()), std::make_move_iterator(entries.begin() + taken));
+
+		next.reset(new chunk_type((std::max)(ChunkCapacity, (entries.size() - taken) * 2), false, key_type(0)));
+		for (std::size_t i = taken; i < entries.size(); ++i) {
+			next->try_append(entries[i]);
+		}
+	}
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t ChunkCapacity>
+inline void chunked_priority_queue<KeyType, ValueType, Comparator, ChunkCapacity>::sort_entries(std::vector<entry_type>& entries) const
+{
+	const comparator_type& comparator(myComparator);
+	std::stable_sort(entries.begin(), entries.end(), [&comparator](const entry_type& a, const entry_type& b) {
+		return comparator(a.first, b.first);
+	});
+}
+
+namespace csldetail
+{
+template <class KeyType, class ValueType>
+inline append_chunk<KeyType, ValueType>::append_chunk(std::size_t capacity, bool bounded, const KeyType& max)
+	: myCapacity(capacity)
+	, myMax(max)
+	, myBounded(bounded)
+	, myAppended(0)
+	, myEntries(new typename std::aligned_storage<sizeof(entry_type), alignof(entry_type)>::type[capacity])
+{
+}
+template <class KeyType, class ValueType>
+inline append_chunk<KeyType, ValueType>::~append_chunk()
+{
+	const std::size_t entries(length());
+	for (std::size_t i = 0; i < entries; ++i) {
+		reinterpret_cast<entry_type*>(&myEntries[i])->~entry_type();
+	}
+}
+template <class KeyType, class ValueType>
+inline const bool append_chunk<KeyType, ValueType>::try_append(entry_type & in)
+{
+	if (!(myAppended.load(std::memory_order_relaxed) < myCapacity)) {
+		return false;
+	}
+
+	const std::size_t slot(myAppended.fetch_add(1, std::memory_order_relaxed));
+	if (!(slot < myCapacity)) {
+		return false;
+	}
+
+	new (&myEntries[slot]) entry_type(std::move(in));
+
+	return true;
+}
+template <class KeyType, class ValueType>
+inline const bool append_chunk<KeyType, ValueType>::empty() const
+{
+	return !myAppended.load(std::memory_order_relaxed);
+}
+template <class KeyType, class ValueType>
+inline const bool append_chunk<KeyType, ValueType>::full() const
+{
+	return !(myAppended.load(std::memory_order_relaxed) < myCapacity);
+}
+template <class KeyType, class ValueType>
+inline void append_chunk<KeyType, ValueType>::take(std::vector<entry_type>& into)
+{
+	const std::size_t entries(length());
+	for (std::size_t i = 0; i < entries; ++i) {
+		entry_type* const entry(reinterpret_cast<entry_type*>(&myEntries[i]));
+		into.push_back(std::move(*entry));
+		entry->~entry_type();
+	}
+	myAppended.store(0, std::memory_order_relaxed);
+}
+template <class KeyType, class ValueType>
+inline const std::size_t append_chunk<KeyType, ValueType>::length() const
+{
+	// Appends past the end fail, but still count
+	return (std::min)(myAppended.load(std::memory_order_relaxed), myCapacity);
+}
+}
+}
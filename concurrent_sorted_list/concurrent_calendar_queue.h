@@ -0,0 +1,510 @@
+// Copyright(c) 2019 Flovin Michaelsen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "concurrent_sorted_list.h"
+#include "shard_gate.h"
+
+namespace gdul
+{
+namespace csldetail
+{
+// Days share the process wide node pool rather than owning one each
+template <class Traits>
+struct calendar_day_traits : Traits
+{
+	static constexpr bool Use_Global_Pool = true;
+};
+}
+
+// A calendar queue (Brown) over concurrent_sorted_lists, with the interface
+// of concurrent_sorted_list. Keys are laid out over a year of day buckets 
+// of equal width, and pops walk the days from the current one. While the 
+// gaps between keys are about even, each day holds a few entries, making 
+// inserts and pops constant time on average. 
+// Day width and count are redrawn once a day grows past Day_Size_Max entries
+// or a pop walks more than Skip_Max empty days. The width becomes three times
+// the mean gap between the entries due next, sampled as Brown does, and the 
+// count follows the size. Redrawing closes the queue while every entry is 
+// moved into the new days, one sorted day at a time, so that inserts and pops
+// pause for time linear in the size. 
+// Entries come out in key order while the queue is at rest. Pops racing 
+// inserts of keys earlier than the current day may take a later key first
+template <class KeyType, class ValueType, class Comparator = csldetail::tiny_less, class Traits = csl_default_traits>
+class concurrent_calendar_queue
+{
+public:
+	typedef concurrent_sorted_list<KeyType, ValueType, Comparator, csldetail::calendar_day_traits<Traits>> list_type;
+	typedef typename list_type::size_type size_type;
+	typedef typename list_type::key_type key_type;
+	typedef typename list_type::value_type value_type;
+	typedef typename list_type::comparator_type comparator_type;
+
+	// Days are laid out by ascending key
+	static_assert(std::is_same<Comparator, csldetail::tiny_less>::value || std::is_same<Comparator, std::less<KeyType>>::value, "concurrent_calendar_queue orders by ascending key only, since a key's day is its distance above the lowest key, and pops walk the days upwards");
+
+	// Redrawing the days reinserts entries, dropping deadlines, and a bound 
+	// per day would not bound the whole
+	static_assert(!Traits::expiry_policy::Expires, "concurrent_calendar_queue does not support expiry");
+	static_assert(!Traits::Capacity, "concurrent_calendar_queue does not support Capacity");
+
+	concurrent_calendar_queue();
+
+	const size_type size() const;
+
+	const bool insert(const std::pair<key_type, value_type>& in);
+	const bool insert(std::pair<key_type, value_type>&& in);
+
+	const bool try_pop(value_type& out);
+	const bool try_pop(std::pair<key_type, value_type>& out);
+
+	// Top key hint
+	const bool try_peek_top_key(key_type& out);
+
+	void unsafe_clear();
+
+	// The current layout. Not to be read while the queue is in use
+	const std::size_t unsafe_day_count() const;
+	const double unsafe_day_width() const;
+
+private:
+	typedef typename std::conditional<std::is_integral<key_type>::value, std::uint64_t, double>::type width_type;
+
+	static constexpr std::size_t Cache_Line_Size = Traits::Cache_Line_Size;
+
+	static constexpr std::size_t Min_Days = 16;
+	static constexpr std::size_t Max_Days = 64 * 1024;
+
+	// Redraw signals
+	static constexpr size_type Day_Size_Max = 16;
+	static constexpr std::size_t Skip_Max = 32;
+
+	// Entries due next that the day width is drawn from
+	static constexpr std::size_t Sample_Size = 32;
+
+	// Keeps day + 1 from wrapping
+	static constexpr std::uint64_t Max_Day = std::uint64_t(1) << 62;
+
+	const std::uint64_t day_of(const key_type& key) const;
+
+	// Distance from low to high, no less than low. Integers are measured as
+	// unsigned, floats as double
+	static const width_type distance(const key_type& low, const key_type& high, std::true_type);
+	static const width_type distance(const key_type& low, const key_type& high, std::false_type);
+
+	list_type& day(std::uint64_t index);
+
+	// Called inside the gate. Entries are not counted
+	const bool insert_internal(std::pair<key_type, value_type>&& in, size_type& daySize);
+	const bool try_pop_internal(std::pair<key_type, value_type>& out, std::size_t& skipped);
+
+	// Lowest key over all days
+	const bool try_find_lowest(key_type& out);
+
+	// Moves the current day back to at most index
+	void lower_day(std::uint64_t index);
+
+	// Called outside the gate
+	void signal_redraw();
+
+	// Called with the gate closed
+	void redraw();
+
+	// Moves entries ordered by ascending key into the days of the current 
+	// layout, a single pass per day
+	void rehash(std::vector<std::pair<key_type, value_type>>& entries, std::vector<std::unique_ptr<list_type>>& into) const;
+	const width_type sampled_width(const std::vector<std::pair<key_type, value_type>>& sample) const;
+
+	// Entered by inserts and pops, closed while redrawing the days
+	csldetail::shard_gate<16, Cache_Line_Size> myGate;
+
+	// Lower bound of the days holding entries
+	std::atomic<std::uint64_t> myDay;
+	CSL_PADD(Cache_Line_Size - (sizeof(std::atomic<std::uint64_t>) % Cache_Line_Size));
+
+	// Redraw signals to pass over before acting on one again
+	std::atomic<std::ptrdiff_t> myRedrawHold;
+	CSL_PADD(Cache_Line_Size - (sizeof(std::atomic<std::ptrdiff_t>) % Cache_Line_Size));
+
+	typename csldetail::with_cache_line<typename Traits::size_policy, Cache_Line_Size>::type mySize;
+
+	// Changed with the gate closed only
+	std::vector<std::unique_ptr<list_type>> myDays;
+	width_type myWidth;
+	key_type myOrigin;
+};
+
+template <class KeyType, class ValueType, class Comparator, class Traits>
+inline concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::concurrent_calendar_queue()
+	: myDay(0)
+	, myRedrawHold(0)
+	, myWidth(1)
+	, myOrigin(0)
+{
+	for (std::size_t i = 0; i < Min_Days; ++i) {
+		myDays.emplace_back(new list_type());
+	}
+}
+template <class KeyType, class ValueType, class Comparator, class Traits>
+inline const typename concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::size_type concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::size() const
+{
+	return mySize.load();
+}
+template <class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::insert(const std::pair<key_type, value_type>& in)
+{
+	return insert(std::pair<key_type, value_type>(in));
+}
+template <class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::insert(std::pair<key_type, value_type>&& in)
+{
+	const std::size_t stripe(myGate.enter());
+
+	size_type daySize(0);
+	const bool result(insert_internal(std::move(in), daySize));
+	if (result) {
+		mySize.add(1);
+	}
+
+	myGate.leave(stripe);
+
+	if (Day_Size_Max < daySize) {
+		signal_redraw();
+	}
+
+	return result;
+}
+template <class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::try_pop(value_type & out)
+{
+	std::pair<key_type, value_type> pair;
+	if (!try_pop(pair)) {
+		return false;
+	}
+	out = std::move(pair.second);
+	return true;
+}
+template <class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::try_pop(std::pair<key_type, value_type>& out)
+{
+	const std::size_t stripe(myGate.enter());
+
+	std::size_t skipped(0);
+	const bool result(try_pop_internal(out, skipped));
+	if (result) {
+		mySize.add(-1);
+	}
+
+	myGate.leave(stripe);
+
+	if (Skip_Max < skipped) {
+		signal_redraw();
+	}
+
+	return result;
+}
+template <class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::try_peek_top_key(key_type & out)
+{
+	const std::size_t stripe(myGate.enter());
+
+	bool result(false);
+
+	const std::uint64_t first(myDay.load(std::memory_order_acquire));
+	for (std::uint64_t index(first); index < first + myDays.size(); ++index) {
+		key_type top = key_type();
+		if (day(index).try_peek_top_key(top) && !(index < day_of(top))) {
+			out = top;
+			result = true;
+			break;
+		}
+	}
+	if (!result) {
+		result = try_find_lowest(out);
+	}
+
+	myGate.leave(stripe);
+
+	return result;
+}
+template <class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::unsafe_clear()
+{
+	for (std::unique_ptr<list_type>& d : myDays) {
+		d->unsafe_clear();
+	}
+	myDay.store(0, std::memory_order_relaxed);
+	myRedrawHold.store(0, std::memory_order_relaxed);
+	mySize.unsafe_reset();
+}
+template <class KeyType, class ValueType, class Comparator, class Traits>
+inline const std::size_t concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::unsafe_day_count() const
+{
+	return myDays.size();
+}
+template <class KeyType, class ValueType, class Comparator, class Traits>
+inline const double concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::unsafe_day_width() const
+{
+	return static_cast<double>(myWidth);
+}
+template <class KeyType, class ValueType, class Comparator, class Traits>
+inline const std::uint64_t concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::day_of(const key_type & key) const
+{
+	if (!(myOrigin < key)) {
+		return 0;
+	}
+
+	const width_type days(distance(myOrigin, key, std::is_integral<key_type>()) / myWidth);
+
+	return days < static_cast<width_type>(Max_Day) ? static_cast<std::uint64_t>(days) : Max_Day;
+}
+template <class KeyType, class ValueType, class Comparator, class Traits>
+inline const typename concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::width_type concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::distance(const key_type & low, const key_type & high, std::true_type)
+{
+	// Wraps signed keys around to unsigned ones of the same order
+	const std::uint64_t min(static_cast<std::uint64_t>((std::numeric_limits<key_type>::min)()));
+
+	return (static_cast<std::uint64_t>(high) - min) - (static_cast<std::uint64_t>(low) - min);
+}
+template <class KeyType, class ValueType, class Comparator, class Traits>
+inline const typename concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::width_type concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::distance(const key_type & low, const key_type & high, std::false_type)
+{
+	return static_cast<double>(high) - static_cast<double>(low);
+}
+template <class KeyType, class ValueType, class Comparator, class Traits>
+inline typename concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::list_type & concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::day(std::uint64_t index)
+{
+	// Day counts are powers of two
+	return *myDays[static_cast<std::size_t>(index & (myDays.size() - 1))];
+}
+template <class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::insert_internal(std::pair<key_type, value_type>&& in, size_type& daySize)
+{
+	const std::uint64_t index(day_of(in.first));
+	list_type& to(day(index));
+
+	if (!to.insert(std::move(in))) {
+		return false;
+	}
+
+	// Pairs with pops moving past a day, then looking at it again. One of the
+	// two is sure to see the other
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	lower_day(index);
+
+	daySize = to.size();
+
+	return true;
+}
+template <class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::try_pop_internal(std::pair<key_type, value_type>& out, std::size_t& skipped)
+{
+	std::uint64_t index(myDay.load(std::memory_order_seq_cst));
+
+	for (std::size_t empty(0);;) {
+		list_type& from(day(index));
+
+		key_type top = key_type();
+		if (from.try_peek_top_key(top) && !(index < day_of(top))) {
+			out.first = top;
+			if (from.compare_try_pop(out)) {
+				return true;
+			}
+			continue;
+		}
+
+		// A year without entries due. Jump straight to the lowest key
+		std::uint64_t next(index + 1);
+		if (!(++empty < myDays.size())) {
+			if (!try_find_lowest(top)) {
+				return false;
+			}
+			next = (std::max)(day_of(top), index);
+			empty = 0;
+		}
+
+		if (!myDay.compare_exchange_strong(index, next, std::memory_order_seq_cst, std::memory_order_seq_cst)) {
+			continue;
+		}
+		++skipped;
+
+		// Inserts behind the new day that did not see it moved need to be
+		// gone back for
+		if (next == index + 1) {
+			if (from.try_peek_top_key(top) && !(index < day_of(top))) {
+				lower_day(day_of(top));
+			}
+		}
+		else if (try_find_lowest(top) && day_of(top) < next) {
+			lower_day(day_of(top));
+		}
+
+		index = myDay.load(std::memory_order_seq_cst);
+	}
+}
+template <class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::try_find_lowest(key_type & out)
+{
+	bool found(false);
+	for (std::unique_ptr<list_type>& d : myDays) {
+		key_type top = key_type();
+		if (d->try_peek_top_key(top) && (!found || top < out)) {
+			out = top;
+			found = true;
+		}
+	}
+	return found;
+}
+template <class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::lower_day(std::uint64_t index)
+{
+	std::uint64_t current(myDay.load(std::memory_order_seq_cst));
+	while (index < current && !myDay.compare_exchange_weak(current, index, std::memory_order_seq_cst, std::memory_order_seq_cst));
+}
+template <class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::signal_redraw()
+{
+	if (0 < myRedrawHold.load(std::memory_order_relaxed) && 0 < myRedrawHold.fetch_sub(1, std::memory_order_relaxed)) {
+		return;
+	}
+
+	if (!myGate.try_close()) {
+		return;
+	}
+
+	redraw();
+
+	myRedrawHold.store(static_cast<std::ptrdiff_t>(myDays.size()), std::memory_order_relaxed);
+
+	myGate.open();
+}
+template <class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::redraw()
+{
+	typedef std::pair<key_type, value_type> entry_type;
+
+	std::vector<entry_type> entries;
+	entries.reserve(Sample_Size);
+
+	std::size_t skipped(0);
+	for (entry_type entry; entries.size() < Sample_Size && try_pop_internal(entry, skipped);) {
+		entries.push_back(std::move(entry));
+	}
+
+	const width_type width(sampled_width(entries));
+
+	std::size_t dayCount(Min_Days);
+	while (dayCount < Max_Days && dayCount < mySize.load() / 2) {
+		dayCount *= 2;
+	}
+
+	// Near enough to leave be
+	if (dayCount == myDays.size() && width / 2 < myWidth && myWidth / 2 < width) {
+		for (entry_type& entry : entries) {
+			size_type daySize(0);
+			insert_internal(std::move(entry), daySize);
+		}
+		return;
+	}
+
+	std::vector<std::unique_ptr<list_type>> days(dayCount);
+	for (std::unique_ptr<list_type>& d : days) {
+		d.reset(new list_type());
+	}
+
+	// The sample was popped lowest first, so its front is the lowest key
+	myWidth = width;
+	myOrigin = entries.empty() ? myOrigin : entries.front().first;
+	myDay.store(0, std::memory_order_relaxed);
+
+	const std::size_t oldCount(myDays.size());
+	myDays.swap(days);
+
+	rehash(entries, myDays);
+
+	// Each old day is in key order already, and moved over on its own
+	for (std::size_t i = 0; i < oldCount; ++i) {
+		entries.clear();
+		for (entry_type entry; days[i]->unsafe_try_pop(entry);) {
+			entries.push_back(std::move(entry));
+		}
+		rehash(entries, myDays);
+	}
+}
+template <class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::rehash(std::vector<std::pair<key_type, value_type>>& entries, std::vector<std::unique_ptr<list_type>>& into) const
+{
+	typedef typename std::vector<std::pair<key_type, value_type>>::iterator iterator_type;
+
+	// Runs of entries bound for the same day are inserted together
+	for (iterator_type first(entries.begin()); first != entries.end();) {
+		const std::size_t index(static_cast<std::size_t>(day_of(first->first) & (into.size() - 1)));
+
+		iterator_type last(first + 1);
+		while (last != entries.end() && static_cast<std::size_t>(day_of(last->first) & (into.size() - 1)) == index) {
+			++last;
+		}
+
+		into[index]->unsafe_insert_sorted(std::make_move_iterator(first), std::make_move_iterator(last));
+
+		first = last;
+	}
+}
+template <class KeyType, class ValueType, class Comparator, class Traits>
+inline const typename concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::width_type concurrent_calendar_queue<KeyType, ValueType, Comparator, Traits>::sampled_width(const std::vector<std::pair<key_type, value_type>>& sample) const
+{
+	if (sample.size() < 2) {
+		return myWidth;
+	}
+
+	const std::size_t gaps(sample.size() - 1);
+	const double mean(static_cast<double>(distance(sample.front().first, sample.back().first, std::is_integral<key_type>())) / gaps);
+
+	// Brown leaves out gaps over twice the mean, as from a straggler
+	double sum(0.0);
+	std::size_t counted(0);
+	for (std::size_t i = 0; i < gaps; ++i) {
+		const double gap(static_cast<double>(distance(sample[i].first, sample[i + 1].first, std::is_integral<key_type>())));
+		if (!(mean * 2.0 < gap)) {
+			sum += gap;
+			++counted;
+		}
+	}
+
+	if (!(0.0 < sum)) {
+		return myWidth;
+	}
+
+	const double width(3.0 * sum / counted);
+
+	return std::is_integral<key_type>::value && width < 1.0 ? width_type(1) : static_cast<width_type>(width);
+}
+}
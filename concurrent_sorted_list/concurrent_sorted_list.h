@@ -20,11 +20,43 @@
 
 #pragma once
 
+#include <new>
+
+// Granularity of false sharing assumed when padding members apart. CPUs that
+// prefetch adjacent line pairs are better served by defining this as 128.
+// Fixed rather than taken from std::hardware_destructive_interference_size,
+// which varies with compiler flags and would let them change the layout.
+// Also used by the node pool's concurrent_queue unless it is configured
+// separately
+#ifndef CSL_CACHE_LINE_SIZE
+#define CSL_CACHE_LINE_SIZE 64
+#endif
+
+#ifndef CQ_CACHE_LINE_SIZE
+#define CQ_CACHE_LINE_SIZE CSL_CACHE_LINE_SIZE
+#endif
+
 #include <atomic>
 #include <atomic_shared_ptr.h>
 #include <vector>
 #include <iostream>
 #include <concurrent_object_pool.h>
+#include <thread>
+#include <memory>
+#include <cstring>
+#include <type_traits>
+#include <algorithm>
+#include <limits>
+#include <chrono>
+#include <functional>
+#include <iterator>
+
+#if defined(__has_include)
+#if __has_include(<memory_resource>) && ((201703L <= __cplusplus) || (defined(_MSVC_LANG) && (201703L <= _MSVC_LANG)))
+#include <memory_resource>
+#define CSL_PMR_SUPPORT
+#endif
+#endif
 
 #ifndef MAKE_UNIQUE_NAME 
 #define CONCAT(a,b)  a##b
@@ -39,37 +71,494 @@ namespace gdul
 namespace csldetail
 {
 
-template <class KeyType, class ValueType>
+template <class KeyType, class ValueType, class Allocator, class Reclamation, class Deadline>
 class node;
 
 struct tiny_less;
 
+template <class KeyType, class ValueType, class Deadline>
+class alloc_type;
+
+template <class AllocType>
+class pool_allocator;
+
+template <class Allocator, class AllocType>
+struct select_allocator;
+
+template <class AllocType>
+concurrent_object_pool<AllocType>& global_node_pool(std::size_t blockSize);
+
+template <class KeyType, std::size_t CacheLineSize, bool Enabled>
+class top_key_cache;
+
+template <class KeyType, class NodeType, class SharedPtrType>
+struct jump_sample;
+template <class SampleType>
+class jump_samples;
+
+template <class KeyType, class Comparator, std::size_t Buckets, std::size_t Shards, std::size_t CacheLineSize, bool Enabled>
+class quantile_sketch;
+template <class KeyType, class SharedPtrType, bool Enabled>
+struct quantile_walk;
+
+struct no_deadline;
+
+template <class TimePoint>
+struct deadline;
+
+template <class KeyType, class ValueType, bool Enabled>
+class expiry_callback;
+
+template <class KeyType, class NodeType, class SharedPtrType, std::size_t CacheLineSize, bool Enabled>
+class jump_index;
+
+inline void prefetch(const void* address);
+
+// Index handed to the calling thread on first use, distinct per thread
+// until wrapping
+inline const std::size_t thread_slot();
+
+enum class insert_result : uint8_t
+{
+	Retry,
+	Inserted,
+	Rejected
+};
+
 }
 
-template <class KeyType, class ValueType, class Comparator = csldetail::tiny_less>
+// Selects allocation of nodes from a concurrent_object_pool. The pool is
+// owned by the list unless one is passed at construction, or Use_Global_Pool
+// is set. Any other allocator_type is rebound to uint8_t and used as is
+struct csl_node_pool_allocator {};
+
+// Node ownership is tracked by atomic_shared_ptr
+struct csl_asp_reclamation
+{
+	template <class T, class Allocator>
+	using shared_ptr_type = shared_ptr<T, Allocator>;
+	template <class T, class Allocator>
+	using atomic_shared_ptr_type = atomic_shared_ptr<T, Allocator>;
+	template <class T, class Allocator>
+	using versioned_raw_ptr_type = versioned_raw_ptr<T, Allocator>;
+};
+
+// Failed attempts are retried immediately
+struct csl_no_backoff
+{
+	inline void operator()() {}
+};
+
+// Failed attempts spin for an exponentially growing number of
+// pauses, and start yielding once Max_Spin is reached
+template <uint32_t Max_Spin = 64>
+class csl_exponential_backoff
+{
+public:
+	inline void operator()();
+
+private:
+	uint32_t mySpin = 1;
+};
+
+// Equal keys are accepted and popped in insertion order
+struct csl_allow_duplicates
+{
+	static constexpr bool Allow_Duplicates = true;
+};
+
+// Inserting a key that compares equal to a present key fails
+struct csl_reject_duplicates
+{
+	static constexpr bool Allow_Duplicates = false;
+};
+
+// No statistics are gathered
+class csl_no_stats
+{
+public:
+	inline void on_insert(std::size_t /*traversed*/, std::size_t /*retries*/) {}
+	inline void on_pop(std::size_t /*retries*/) {}
+	inline void on_failed_pop() {}
+};
+
+// Relaxed counters of list activity. Approximate while the list is in use.
+// Padded so that counting does not disturb the neighbouring list members. 
+// Lists pad by the Cache_Line_Size of their traits instead of CacheLineSize
+template <std::size_t CacheLineSize = CSL_CACHE_LINE_SIZE>
+class csl_atomic_stats
+{
+public:
+	csl_atomic_stats();
+
+	inline void on_insert(std::size_t traversed, std::size_t retries);
+	inline void on_pop(std::size_t retries);
+	inline void on_failed_pop();
+
+	inline const std::size_t inserts() const;
+	inline const std::size_t insert_retries() const;
+	inline const std::size_t traversed_nodes() const;
+	inline const std::size_t pops() const;
+	inline const std::size_t pop_retries() const;
+	inline const std::size_t failed_pops() const;
+
+private:
+	CSL_PADD(CacheLineSize);
+	std::atomic<std::size_t> myInserts;
+	std::atomic<std::size_t> myInsertRetries;
+	std::atomic<std::size_t> myTraversedNodes;
+	std::atomic<std::size_t> myPops;
+	std::atomic<std::size_t> myPopRetries;
+	std::atomic<std::size_t> myFailedPops;
+	CSL_PADD(CacheLineSize - ((sizeof(std::atomic<std::size_t>) * 6) % CacheLineSize));
+};
+
+// Entries never expire
+struct csl_no_expiry
+{
+	static constexpr bool Expires = false;
+
+	typedef std::chrono::steady_clock::time_point time_point;
+	typedef csldetail::no_deadline deadline_type;
+
+	static inline time_point now() { return time_point(); }
+};
+
+// Entries inserted with a deadline expire once Clock passes it. Expired 
+// entries are unlinked by whichever insert or pop comes across them
+template <class Clock = std::chrono::steady_clock>
+struct csl_clock_expiry
+{
+	static constexpr bool Expires = true;
+
+	typedef typename Clock::time_point time_point;
+	typedef csldetail::deadline<time_point> deadline_type;
+
+	static inline time_point now() { return Clock::now(); }
+};
+
+// Quantiles of the queued keys are not tracked
+struct csl_no_quantiles
+{
+	static constexpr bool Tracks_Quantiles = false;
+	static constexpr std::size_t Buckets = 2;
+	static constexpr std::size_t Shards = 1;
+};
+
+// Keeps a histogram of the queued keys for key_quantile. Bucket bounds are 
+// drawn at even ranks by walking the list, and redrawn once about as many 
+// entries have come and gone as the list held then. The redrawing walk is 
+// spread over the inserts and removals that follow, a few nodes at a time,
+// so that none of them pays for the whole list. Inserts and removals 
+// count into one of Shards padded shards, picked per thread, and the shards 
+// are summed on reading. Removals subtract from the very bucket their insert 
+// added to, so pops need no special handling
+template <std::size_t BucketCount = 64, std::size_t ShardCount = 8>
+struct csl_quantile_sketch
+{
+	static constexpr bool Tracks_Quantiles = true;
+	static constexpr std::size_t Buckets = BucketCount;
+	static constexpr std::size_t Shards = ShardCount;
+
+	static_assert(1 < Buckets, "A quantile sketch needs at least two buckets");
+};
+
+// One counter written by every insert and pop. Pops reserve an entry 
+// against it before touching the list, so size() is exact
+class csl_atomic_size
+{
+public:
+	static constexpr bool Reserve_On_Pop = true;
+
+	csl_atomic_size();
+
+	inline void add(std::ptrdiff_t delta);
+
+	// Returns false if there was nothing to reserve
+	inline const bool try_reserve();
+
+	inline const std::size_t load() const;
+
+	inline void unsafe_add(std::ptrdiff_t delta);
+	inline void unsafe_reset();
+
+private:
+	std::atomic<std::size_t> myCount;
+};
+
+// Counts are spread over Shards padded counters, each thread writing 
+// to its own. size() becomes an approximation summed over all shards, and 
+// pops find the list empty from the front link instead of by reservation.
+// Lists pad by the Cache_Line_Size of their traits instead of CacheLineSize
+template <std::size_t Shards = 16, std::size_t CacheLineSize = CSL_CACHE_LINE_SIZE>
+class csl_sharded_size
+{
+public:
+	static constexpr bool Reserve_On_Pop = false;
+
+	csl_sharded_size();
+
+	inline void add(std::ptrdiff_t delta);
+
+	// Never reserves
+	inline const bool try_reserve() { return true; }
+
+	inline const std::size_t load() const;
+
+	inline void unsafe_add(std::ptrdiff_t delta);
+	inline void unsafe_reset();
+
+private:
+	struct shard
+	{
+		std::atomic<std::ptrdiff_t> myCount;
+		CSL_PADD(CacheLineSize - (sizeof(std::atomic<std::ptrdiff_t>) % CacheLineSize));
+	};
+	shard myShards[Shards];
+};
+
+namespace csldetail
+{
+// Policy, padded by CacheLineSize in place of its own line size
+template <class Policy, std::size_t CacheLineSize>
+struct with_cache_line
+{
+	typedef Policy type;
+};
+template <std::size_t From, std::size_t CacheLineSize>
+struct with_cache_line<csl_atomic_stats<From>, CacheLineSize>
+{
+	typedef csl_atomic_stats<CacheLineSize> type;
+};
+template <std::size_t Shards, std::size_t From, std::size_t CacheLineSize>
+struct with_cache_line<csl_sharded_size<Shards, From>, CacheLineSize>
+{
+	typedef csl_sharded_size<Shards, CacheLineSize> type;
+};
+}
+
+// Compile time configuration of concurrent_sorted_list. Derive from 
+// csl_default_traits and shadow the members that should differ. All 
+// policies are resolved statically, so disabled features cost nothing
+struct csl_default_traits
+{
+	// Number of nodes allocated per block by the node pool
+	static constexpr std::size_t Pool_Block_Size = 128;
+
+	// Default constructed lists draw nodes from a process wide pool, shared 
+	// by all lists of the same node type, instead of owning one
+	static constexpr bool Use_Global_Pool = false;
+
+	// Granularity used when padding contended members apart
+	static constexpr std::size_t Cache_Line_Size = CSL_CACHE_LINE_SIZE;
+
+	// Writers of the front link publish the top key to a separately padded,
+	// seqlock protected cache. try_peek_top_key then reads without writing
+	static constexpr bool Publish_Top_Key = false;
+
+	// Pops only tag the node they take, leaving the front link on a prefix of
+	// deleted nodes that later pops walk past (Linden and Jonsson). The pop 
+	// finding this many unlinks them all with one exchange of the front link.
+	// Inserts step over deleted nodes rather than unlink them one at a time.
+	// 0 unlinks on every pop
+	static constexpr std::size_t Pop_Batch_Threshold = 0;
+
+	// Only one thread ever pops. Pops then find the list empty from the front
+	// link instead of reserving against the size, never retry against other 
+	// poppers and count themselves on a counter of their own. The tag on the
+	// popped node and the exchange of the front link remain, as inserts may 
+	// land behind or ahead of it
+	static constexpr bool Single_Consumer = false;
+
+	// Every Jump_Index_Stride:th node is sampled into a sorted index that 
+	// inserts binary search for a starting point. The index is rebuilt
+	// when inserts find it stale. 0 disables the index
+	static constexpr std::size_t Jump_Index_Stride = 0;
+
+	// Rebuilds of the jump index advance this many nodes per insert, taken 
+	// in turn by whichever inserts come along, so that no single insert walks 
+	// the whole list. The previous index serves meanwhile. 0 rebuilds in one go
+	static constexpr std::size_t Jump_Index_Rebuild_Step = 0;
+
+	// The jump index is first built once inserts traverse more than this many
+	// nodes, and is dropped once the list shrinks below this many entries, 
+	// leaving small lists a plain list. 0 keeps the index at any size
+	static constexpr std::size_t Jump_Index_Min_Size = 0;
+
+	// Inserts and evictions update a count per jump index segment, keeping 
+	// rank_approx and select_approx current between rebuilds, at the cost of 
+	// a few shared counter updates per insert. Without, counts are only set 
+	// by rebuilds
+	static constexpr bool Jump_Index_Counts = false;
+
+	// How many nodes ahead of the current one insert traversal prefetches.
+	// 1 fetches the next node, 2 the node after it. 0 disables prefetching
+	static constexpr std::size_t Prefetch_Distance = 0;
+
+	// Keeps only the Capacity best entries. Once full, inserts keyed no better 
+	// than the cached key of the worst entry are turned away without traversal,
+	// while the rest evict the worst entry from the tail. Enforced by insert 
+	// and merge. 0 leaves the list unbounded
+	static constexpr std::size_t Capacity = 0;
+
+	typedef csl_node_pool_allocator allocator_type;
+	typedef csl_asp_reclamation reclamation_policy;
+	typedef csl_no_backoff backoff_policy;
+	typedef csl_allow_duplicates duplicate_policy;
+	typedef csl_no_stats stats_policy;
+	typedef csl_atomic_size size_policy;
+	typedef csl_no_expiry expiry_policy;
+	typedef csl_no_quantiles quantile_policy;
+};
+
+// Default constructed lists share the process wide node pool. Construction
+// of such a list does not allocate
+struct csl_global_pool_traits : csl_default_traits
+{
+	static constexpr bool Use_Global_Pool = true;
+};
+
+// Starts out as a plain list, and brings up a jump index step by step as
+// the list grows, dropping it again as the list shrinks
+struct csl_adaptive_traits : csl_default_traits
+{
+	static constexpr std::size_t Jump_Index_Stride = 64;
+	static constexpr std::size_t Jump_Index_Rebuild_Step = 1024;
+	static constexpr std::size_t Jump_Index_Min_Size = 1024;
+};
+
+// Any number of inserting threads, but only one popping thread
+struct csl_single_consumer_traits : csl_default_traits
+{
+	static constexpr bool Single_Consumer = true;
+};
+
+#ifdef CSL_PMR_SUPPORT
+// Nodes are allocated from the std::pmr::memory_resource passed at construction
+struct csl_pmr_traits : csl_default_traits
+{
+	typedef std::pmr::polymorphic_allocator<uint8_t> allocator_type;
+};
+#endif
+
+namespace csldetail
+{
+// Pushed onto the raised list of its watcher after a change to the front of
+// the list it belongs to. Pushed once until lowered by the watcher
+class front_signal
+{
+public:
+	front_signal();
+
+	void raise();
+
+	// Changes from here on are pushed onto raised, tagged with index
+	void watch(std::atomic<front_signal*>& raised, std::size_t index);
+
+	// Returns once raises in flight are done
+	void unwatch();
+
+	// Called by the watcher before rereading the front, so that later 
+	// changes raise anew
+	void lower();
+
+	const std::size_t index() const;
+	front_signal* const next() const;
+
+private:
+	std::atomic<std::atomic<front_signal*>*> myRaisedList;
+	std::atomic<uint32_t> myRaising;
+	std::atomic<bool> myRaised;
+	std::atomic<front_signal*> myNext;
+	std::size_t myIndex;
+};
+}
+
+template <class List>
+class merged_view;
+
+template <class KeyType, class ValueType, class Comparator = csldetail::tiny_less, class Traits = csl_default_traits>
 class concurrent_sorted_list
 {
 private:
-	template <class Dummy>
-	class allocator;
+	typedef csldetail::alloc_type<KeyType, ValueType, typename Traits::expiry_policy::deadline_type> alloc_type;
 
 public:
 	typedef size_t size_type;
 	typedef Comparator comparator_type;
 	typedef KeyType key_type;
 	typedef ValueType value_type;
-	typedef allocator<uint8_t> allocator_type;
-	typedef shared_ptr<csldetail::node<key_type, value_type>, allocator_type> shared_ptr_type;
-	typedef atomic_shared_ptr<csldetail::node<key_type, value_type>, allocator_type> atomic_shared_ptr_type;
-	typedef versioned_raw_ptr<csldetail::node<key_type, value_type>, allocator_type> versioned_raw_ptr_type;
+	typedef Traits traits_type;
+	typedef typename traits_type::reclamation_policy reclamation_policy;
+	typedef typename traits_type::backoff_policy backoff_policy;
+	typedef typename traits_type::duplicate_policy duplicate_policy;
+	typedef typename csldetail::with_cache_line<typename traits_type::stats_policy, traits_type::Cache_Line_Size>::type stats_policy;
+	typedef typename csldetail::with_cache_line<typename traits_type::size_policy, traits_type::Cache_Line_Size>::type size_policy;
+	typedef typename traits_type::expiry_policy expiry_policy;
+	typedef typename traits_type::quantile_policy quantile_policy;
+	typedef typename expiry_policy::time_point time_point;
+	typedef typename csldetail::select_allocator<typename traits_type::allocator_type, alloc_type>::type allocator_type;
+	typedef concurrent_object_pool<alloc_type> pool_type;
+	typedef csldetail::node<key_type, value_type, allocator_type, reclamation_policy, typename expiry_policy::deadline_type> node_type;
+	typedef typename reclamation_policy::template shared_ptr_type<node_type, allocator_type> shared_ptr_type;
+	typedef typename reclamation_policy::template atomic_shared_ptr_type<node_type, allocator_type> atomic_shared_ptr_type;
+	typedef typename reclamation_policy::template versioned_raw_ptr_type<node_type, allocator_type> versioned_raw_ptr_type;
 
 	concurrent_sorted_list();
+	explicit concurrent_sorted_list(const allocator_type& allocator);
+
+	// Draw nodes from a pool shared with other lists. The pool must
+	// outlive the list. Only available with csl_node_pool_allocator
+	explicit concurrent_sorted_list(pool_type& sharedPool);
+
 	~concurrent_sorted_list();
 
+	// The process wide pool used with Use_Global_Pool
+	static pool_type& global_pool();
+
+	// Exact with csl_atomic_size, an approximation with csl_sharded_size
 	const size_type size() const;
 
-	void insert(const std::pair<key_type, value_type>& in);
-	void insert(std::pair<key_type, value_type>&& in);
+	// Counts the entries by walking the list. Exact while the list is at rest
+	const size_type size_exact();
+
+	// The number of entries keyed below key, and the key of the entry with k
+	// entries ahead of it. Found by walking the list, exact while it is at rest
+	const size_type rank(const key_type& key);
+	const bool select(size_type k, key_type& out);
+
+	// Estimates of rank and select, read off the segment counts of the jump 
+	// index in logarithmic time. Off by about a segment's length, plus what 
+	// has been erased or expired since the last rebuild, and with drift from 
+	// inserts unless Jump_Index_Counts. Walk the list while there is no index
+	const size_type rank_approx(const key_type& key);
+	const bool select_approx(size_type k, key_type& out);
+
+	// Estimates the key below which the fraction q of the entries lie, from 
+	// the histogram kept by quantile_policy. Interpolates within buckets. 
+	// Returns false while the histogram is empty. Only available with a 
+	// quantile_policy that tracks
+	const bool key_quantile(double q, key_type& out);
+
+	// Redraws the quantile histogram from the current list in one walk. 
+	// Happens on its own as the list turns over, a few nodes per operation. 
+	// Only available with a quantile_policy that tracks
+	void rebuild_quantiles();
+
+	// Returns false if the entry was turned away by the duplicate policy, or 
+	// for not making the cut of a full list bounded by Capacity
+	const bool insert(const std::pair<key_type, value_type>& in);
+	const bool insert(std::pair<key_type, value_type>&& in);
+
+	// Inserts an entry that expires at deadline. Only available with an 
+	// expiry_policy that expires
+	const bool insert(const std::pair<key_type, value_type>& in, const time_point& deadline);
+	const bool insert(std::pair<key_type, value_type>&& in, const time_point& deadline);
+
+	// Called on the thread that finds an entry expired, with the entry. Set 
+	// before the list is shared between threads
+	typedef std::function<void(const key_type&, value_type&)> expiry_callback_type;
+	void set_expiry_callback(expiry_callback_type callback);
 
 	const bool try_pop(value_type& out);
 	const bool try_pop(std::pair<key_type, value_type>& out);
@@ -83,253 +572,2592 @@ public:
 
 	void unsafe_clear();
 
-private:
-	struct alloc_size_rep
-	{
-		std::pair<key_type, value_type> dummy1;
-		atomic_shared_ptr<int> dummy2;
-	};
-	class alloc_type
-	{
-		uint8_t myBlock[shared_ptr<alloc_size_rep>::Alloc_Size_Make_Shared];
-	};
+	// Exclusive access versions of insert and pop, using plain loads and 
+	// stores. The caller guarantees no other thread touches the list
+	const bool unsafe_insert(const std::pair<key_type, value_type>& in);
+	const bool unsafe_insert(std::pair<key_type, value_type>&& in);
 
-	template <class Dummy>
-	class allocator
-	{
-	public:
-		allocator(concurrent_object_pool<alloc_type>* memPool) : myMemoryPool(memPool) {}
-		allocator(const allocator<uint8_t>& other) : myMemoryPool(other.myMemoryPool) {}
+	const bool unsafe_try_pop(value_type& out);
+	const bool unsafe_try_pop(std::pair<key_type, value_type>& out);
 
-		typedef uint8_t value_type;
+	// Inserts a range ordered by ascending key in a single pass over the list.
+	// Entries are moved into the list when read through move iterators.
+	// Returns the number of entries inserted
+	template <class InputIt>
+	const size_type unsafe_insert_sorted(InputIt first, InputIt last);
 
-		uint8_t* allocate(std::size_t /*n*/) {
-			return reinterpret_cast<uint8_t*>(myMemoryPool->get_object());
-		}
-		void deallocate(uint8_t* ptr, std::size_t /*n*/) {
-			myMemoryPool->recycle_object(reinterpret_cast<alloc_type*>(ptr));
-		}
+	// Links the entries of other into this list in a single pass, leaving 
+	// other empty. Pops may run concurrently on either list, while inserts 
+	// into other may stay behind. Nodes are moved over when both lists 
+	// allocate from the same place, and copied otherwise. Returns the number 
+	// of entries merged
+	const size_type merge(concurrent_sorted_list&& other);
 
-	private:
-		concurrent_object_pool<alloc_type>* myMemoryPool;
-	};
+	// Cuts the entries keyed key or above off into suffix, with a single link
+	// exchange. suffix must be empty and not in use by other threads, and takes 
+	// on the node pool of this list. Pops may run concurrently, while racing 
+	// inserts may end up in either list. Returns the number of entries moved
+	const size_type split_at(const key_type& key, concurrent_sorted_list& suffix);
+
+	// Removes the entries keyed lo or above and below hi. They are marked 
+	// deleted in one pass, then unlinked together by a single exchange of the 
+	// link in front of them. Returns the number of entries removed
+	const size_type erase_range(const key_type& lo, const key_type& hi);
+
+	// Only meaningful when stats_policy gathers anything
+	const stats_policy& get_stats() const;
+
+	// Resamples the jump index from the current list. Happens on its own 
+	// as inserts find the index stale. Only available with Jump_Index_Stride
+	void rebuild_index();
+
+	// Whether inserts currently start from a jump index
+	const bool indexed() const;
+
+private:
+	// Watches myFrontSignal
+	template <class List>
+	friend class merged_view;
 
+	static constexpr bool Uses_Pool = std::is_same<allocator_type, csldetail::pool_allocator<alloc_type>>::value;
 
-	const bool try_insert(shared_ptr_type& entry);
+	allocator_type default_allocator(std::true_type);
+	allocator_type default_allocator(std::false_type);
+
+	// Searches from the link 'from', or from the jump index if nullptr
+	const bool insert_node(shared_ptr_type& entry);
+	const csldetail::insert_result try_insert(shared_ptr_type& entry, std::size_t& traversed, atomic_shared_ptr_type* from);
 	const bool try_pop_internal(key_type& expectedKey, value_type& outValue, const bool matchKey);
+	const bool try_pop_batched(key_type& expectedKey, value_type& outValue, const bool matchKey);
+	const bool try_pop_single(key_type& expectedKey, value_type& outValue, const bool matchKey);
+	const bool unsafe_try_pop_internal(key_type& outKey, value_type& outValue);
+
+	// Finds the link to insert key at, starting from 'from'. Unlinks deleted
+	// nodes on the way. Returns nullptr if the duplicate policy rejects key
+	atomic_shared_ptr_type* unsafe_find_insertion_point(atomic_shared_ptr_type* from, const key_type& key);
+	void unsafe_link(atomic_shared_ptr_type& at, shared_ptr_type&& entry);
+	void unsafe_unlink(atomic_shared_ptr_type& at, node_type* node);
+
+	// Swings link from expected to desired. Publishes the new top key if link 
+	// is the front link
+	const bool exchange_link(atomic_shared_ptr_type& link, versioned_raw_ptr_type& expected, shared_ptr_type&& desired);
+	const bool exchange_front(versioned_raw_ptr_type& expected, shared_ptr_type&& desired);
+
+	// Republishes the top key after a change to the front link. Concurrent
+	// callers are combined, leaving the work to whichever one holds the cache
+	void publish_front();
+	void unsafe_publish_front();
+
+	// Swings the front link past head. Should an insert land ahead of head
+	// first, head is unlinked from behind its new predecessor instead. 
+	// Returns true if the new front turns out to be deleted as well
+	const bool unlink_front(shared_ptr_type& head, shared_ptr_type&& next);
+
+	// Unlinks deleted nodes whose poppers lost the race to unlink them
+	// from the front, so that the front rests on a live node
+	void unlink_deleted_front();
+
+	// Unlinks the run of deleted nodes behind link, if any, in one exchange. 
+	// Returns false if link belongs to a node deleted since
+	const bool unlink_deleted(atomic_shared_ptr_type& link);
+
+	// Unlinks deleted nodes ordered no later than key, from the front
+	void unlink_deleted_through(const key_type& key);
+
+	// Tags the links of an unlinked run of nodes, first up to end, deleted 
+	// one node at a time
+	void release_run(shared_ptr_type first, const node_type* end);
+
+	// Cuts the nodes behind head off into chain, then claims head as a pop 
+	// would and carries a copy of it in front of chain. Poppers that loaded 
+	// head may still tag it, but none can reach chain. Fails if head was 
+	// popped before the cut
+	const bool try_detach_after(shared_ptr_type& head, shared_ptr_type& chain);
+
+	// Takes the entries not yet popped from first on off the size and key 
+	// counts of this list. Returns their number
+	const size_type uncount(node_type* first);
+
+	static constexpr std::size_t Cache_Line_Size = traits_type::Cache_Line_Size;
+	static constexpr std::size_t Capacity = traits_type::Capacity;
+	static constexpr std::size_t Prefetch_Distance = traits_type::Prefetch_Distance;
+
+	// Nodes further ahead than this cannot be reached without dereferencing
+	// nodes the traversal holds no reference to
+	static_assert(Prefetch_Distance <= 2, "Prefetch_Distance may be at most 2");
+
+	static void prefetch_ahead(node_type* next);
+
+	static constexpr std::size_t Pop_Batch_Threshold = traits_type::Pop_Batch_Threshold;
+
+	// The top key cache would publish the deleted nodes left at the front
+	static_assert(!Pop_Batch_Threshold || !traits_type::Publish_Top_Key, "Pop_Batch_Threshold cannot be combined with Publish_Top_Key");
 
+	// Batches spare poppers unlinking after each other, of which there is one
+	static_assert(!Pop_Batch_Threshold || !traits_type::Single_Consumer, "Pop_Batch_Threshold cannot be combined with Single_Consumer");
 
-	std::atomic<size_type> mySize;
+	static constexpr std::size_t Jump_Index_Stride = traits_type::Jump_Index_Stride;
 
-	CSL_PADD(64 - (sizeof(mySize) % 64));
-	concurrent_object_pool<alloc_type> myMemoryPool;
+	typedef csldetail::jump_index<key_type, node_type, shared_ptr_type, Cache_Line_Size, (0 < Jump_Index_Stride)> jump_index_type;
+	typedef typename jump_index_type::samples_ptr_type jump_samples_ptr_type;
+
+	static constexpr std::size_t Jump_Index_Rebuild_Step = traits_type::Jump_Index_Rebuild_Step;
+	static constexpr std::size_t Jump_Index_Min_Size = traits_type::Jump_Index_Min_Size;
+	static constexpr bool Jump_Index_Counts = traits_type::Jump_Index_Counts;
+
+	// Builds, advances or drops the jump index following an insert that
+	// traversed the given number of nodes
+	void maintain_index(std::size_t traversed, std::true_type);
+	void maintain_index(std::size_t traversed, std::false_type);
+
+	// Discards the jump index along with any rebuild under way
+	void drop_index();
+
+	// Lets with allocate from, and keep alive, the node pool of this list
+	void share_allocator(concurrent_sorted_list& with, std::true_type);
+	void share_allocator(concurrent_sorted_list& with, std::false_type);
+
+	// Turns away keys no better than the worst entry of a full list
+	const bool admit(const key_type& key) const;
+
+	// Evicts the worst entry of an overfull list, or else notes a new worst key
+	void bound_size(const key_type& inserted);
+	void evict_tail();
+
+	// Counts an entry that came or went into the quantile histogram, 
+	// advancing the redrawing walk when due
+	void count_key(const key_type& key, std::ptrdiff_t delta);
+
+	// Called holding the sketch's rebuild flag, or exclusive access
+	void redraw_quantiles();
+	void step_quantile_walk(std::true_type);
+	void step_quantile_walk(std::false_type);
+
+	// Nodes visited per step of the redrawing walk
+	static constexpr std::size_t Quantile_Walk_Step = 64;
+
+	// Claims node as expired, returning its tagged successor
+	shared_ptr_type expire(node_type* node);
+	void on_expired(node_type* node);
+
+	// The link after the last live sample ahead of segment, or the front link
+	atomic_shared_ptr_type* jump_start(const jump_samples_ptr_type& samples, std::size_t segment);
+
+	// Index of the first sample keyed key or above, closing the segment key falls in
+	const std::size_t jump_segment(const jump_samples_ptr_type& samples, const key_type& key) const;
+
+	// Walks to the first live node not ordered before key, unlinking deleted
+	// nodes on the way. Leaves link pointing at current. Returns false if the
+	// walk must restart
+	const bool find_link(const key_type& key, const jump_samples_ptr_type& samples, atomic_shared_ptr_type*& link, shared_ptr_type& last, shared_ptr_type& current);
+
+	// Written by every insert and pop
+	size_policy mySize;
+	CSL_PADD(Cache_Line_Size - (sizeof(mySize) % Cache_Line_Size));
+
+	// Link to the first node, in place of a sentry node. Written by 
+	// every pop and every insert at the front
+	atomic_shared_ptr_type myFrontSentry;
+
+	// Stored to by the consumer alone, with Single_Consumer
+	std::atomic<size_type> myConsumerPops;
+	CSL_PADD(Cache_Line_Size - ((sizeof(myFrontSentry) + sizeof(std::atomic<size_type>)) % Cache_Line_Size));
+
+	// Read by peeks, written after changes to the front link
+	csldetail::top_key_cache<key_type, Cache_Line_Size, traits_type::Publish_Top_Key> myTopKey;
+
+	// Raised after changes to the front link, while watched by a merged_view
+	csldetail::front_signal myFrontSignal;
+	CSL_PADD(Cache_Line_Size - (sizeof(csldetail::front_signal) % Cache_Line_Size));
+
+	// Key of the last entry, read by inserts into a list bounded by Capacity
+	std::atomic<key_type> myTailKey;
+
+	// Loaded by every insert
+	jump_index_type myJumpIndex;
+
+	// Counted into by every insert and removal, when tracking quantiles
+	csldetail::quantile_sketch<key_type, comparator_type, quantile_policy::Buckets, quantile_policy::Shards, Cache_Line_Size, quantile_policy::Tracks_Quantiles> myQuantiles;
+
+	// Held by whoever holds the sketch's rebuild flag
+	csldetail::quantile_walk<key_type, shared_ptr_type, quantile_policy::Tracks_Quantiles> myQuantileWalk;
+
+	// Read mostly
+	// Shared with lists split off from this one
+	std::shared_ptr<pool_type> myOwnedPool;
 	allocator_type myAllocator;
-	CSL_PADD(64 - ((sizeof(myMemoryPool) + sizeof(myAllocator)) % 64));
-	shared_ptr_type myFrontSentry;
 	comparator_type myComparator;
 
+	stats_policy myStats;
+
+	csldetail::expiry_callback<key_type, value_type, expiry_policy::Expires> myExpiryCallback;
 };
 
-template<class KeyType, class ValueType, class Comparator>
-inline concurrent_sorted_list<KeyType, ValueType, Comparator>::concurrent_sorted_list()
-	: mySize(0)
-	, myMemoryPool(128)
-	, myAllocator(&myMemoryPool)
-	, myFrontSentry(make_shared<csldetail::node<key_type, value_type>, allocator_type>(myAllocator))
+// A list that starts out plain and is indexed while large
+template <class KeyType, class ValueType, class Comparator = csldetail::tiny_less>
+using adaptive_sorted_list = concurrent_sorted_list<KeyType, ValueType, Comparator, csl_adaptive_traits>;
+
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::concurrent_sorted_list()
+	: myFrontSentry(nullptr)
+	, myConsumerPops(0)
+	, myTailKey((std::numeric_limits<key_type>::max)())
+	, myAllocator(default_allocator(std::integral_constant<bool, Uses_Pool>()))
 {
 	static_assert(std::is_integral<key_type>::value || std::is_floating_point<key_type>::value, "Only integers and floats allowed as key type");
 }
-template<class KeyType, class ValueType, class Comparator>
-inline concurrent_sorted_list<KeyType, ValueType, Comparator>::~concurrent_sorted_list()
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::concurrent_sorted_list(const allocator_type& allocator)
+	: myFrontSentry(nullptr)
+	, myConsumerPops(0)
+	, myTailKey((std::numeric_limits<key_type>::max)())
+	, myAllocator(allocator)
 {
-	unsafe_clear();
+	static_assert(std::is_integral<key_type>::value || std::is_floating_point<key_type>::value, "Only integers and floats allowed as key type");
 }
-template<class KeyType, class ValueType, class Comparator>
-inline const typename concurrent_sorted_list<KeyType, ValueType, Comparator>::size_type concurrent_sorted_list<KeyType, ValueType, Comparator>::size() const
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::concurrent_sorted_list(pool_type& sharedPool)
+	: concurrent_sorted_list(allocator_type(&sharedPool))
 {
-	return mySize.load(std::memory_order_acquire);
 }
-template<class KeyType, class ValueType, class Comparator>
-inline void concurrent_sorted_list<KeyType, ValueType, Comparator>::insert(const std::pair<key_type, value_type>& in)
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::~concurrent_sorted_list()
 {
-	insert(std::pair<key_type, value_type>(in));
+	unsafe_clear();
 }
-template<class KeyType, class ValueType, class Comparator>
-inline void concurrent_sorted_list<KeyType, ValueType, Comparator>::insert(std::pair<key_type, value_type>&& in)
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const typename concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::size_type concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::size() const
 {
-	shared_ptr_type entry(make_shared<csldetail::node<key_type, value_type>, allocator_type>(myAllocator));
-	entry->myKeyValuePair = std::move(in);
+	if (!traits_type::Single_Consumer) {
+		return mySize.load();
+	}
 
-	while (!try_insert(entry));
+	const size_type popped(myConsumerPops.load(std::memory_order_acquire));
+	const size_type counted(mySize.load());
 
-	mySize.fetch_add(1, std::memory_order_relaxed);
+	// Nodes may be popped before their insert has been counted
+	return popped < counted ? counted - popped : 0;
 }
-template<class KeyType, class ValueType, class Comparator>
-inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator>::try_pop(value_type & out)
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const typename concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::size_type concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::size_exact()
 {
-	key_type dummy(0);
-	return try_pop_internal(dummy, out, false);
-}
+	size_type count(0);
 
-template<class KeyType, class ValueType, class Comparator>
-inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator>::try_pop(std::pair<key_type, value_type>& out)
-{
-	return try_pop_internal(out.first, out.second, false);
-}
+	for (shared_ptr_type current(myFrontSentry.load()); current; current = current->myNext.load()) {
+		if (!current->myNext.get_tag()) {
+			++count;
+		}
+	}
 
-template<class KeyType, class ValueType, class Comparator>
-inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator>::compare_try_pop(std::pair<key_type, value_type>& out)
-{
-	return try_pop_internal(out.first, out.second, true);
+	return count;
 }
-
-template<class KeyType, class ValueType, class Comparator>
-inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator>::try_peek_top_key(key_type & out)
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const typename concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::size_type concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::rank(const key_type & key)
 {
-	const shared_ptr_type head(myFrontSentry->myNext.load());
+	const time_point now(expiry_policy::now());
 
-	if (!head) {
-		return false;
-	}
+	size_type count(0);
 
-	out = head->myKeyValuePair.first;
+	for (shared_ptr_type current(myFrontSentry.load()); current && myComparator(current->myKeyValuePair.first, key); current = current->myNext.load()) {
+		if (!current->myNext.get_tag() && !current->expired(now)) {
+			++count;
+		}
+	}
 
-	return true;
+	return count;
 }
-
-template<class KeyType, class ValueType, class Comparator>
-inline void concurrent_sorted_list<KeyType, ValueType, Comparator>::unsafe_clear()
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::select(size_type k, key_type & out)
 {
-	std::vector<csldetail::node<key_type, value_type>*> arr;
-	arr.reserve(mySize.load(std::memory_order_acquire));
-
-	csldetail::node<key_type, value_type>* prev(static_cast<csldetail::node<key_type, value_type>*>(myFrontSentry));
+	const time_point now(expiry_policy::now());
 
-	for (size_t i = 0; i < mySize.load(std::memory_order_relaxed); ++i) {
-		prev = static_cast<csldetail::node<key_type, value_type>*>(prev->myNext);
-		arr.push_back(prev);
-	}
-	for (typename std::vector<csldetail::node<key_type, value_type>*>::reverse_iterator it = arr.rbegin(); it != arr.rend(); ++it) {
-		(*it)->myNext.unsafe_store(nullptr);
+	for (shared_ptr_type current(myFrontSentry.load()); current; current = current->myNext.load()) {
+		if (current->myNext.get_tag() || current->expired(now)) {
+			continue;
+		}
+		if (!k--) {
+			out = current->myKeyValuePair.first;
+			return true;
+		}
 	}
-	mySize.store(0, std::memory_order_relaxed);
-}
 
-template<class KeyType, class ValueType, class Comparator>
-inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator>::try_insert(shared_ptr_type& entry)
+	return false;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const typename concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::size_type concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::rank_approx(const key_type & key)
 {
-	shared_ptr_type last(nullptr);
-	shared_ptr_type current(myFrontSentry->myNext.load());
+	const jump_samples_ptr_type samples(myJumpIndex.load());
 
-	csldetail::node<key_type, value_type>* insertionPoint(static_cast<csldetail::node<key_type, value_type>*>(myFrontSentry));
+	if (!samples || samples->empty()) {
+		return rank(key);
+	}
 
-	while (current) {
-		if (myComparator(entry->myKeyValuePair.first, current->myKeyValuePair.first)) {
-			break;
-		}
+	// Counted from the back, which pops leave be. Half of the segment key 
+	// falls in is taken to lie ahead of it
+	const std::size_t segment(jump_segment(samples, key));
+	const std::ptrdiff_t behindSegment(samples->weight_from(segment + 1));
+	const std::ptrdiff_t behind(behindSegment + (samples->weight_from(segment) - behindSegment) / 2);
+
+	const size_type entries(size());
+
+	return static_cast<size_type>(behind) < entries ? entries - static_cast<size_type>(behind) : 0;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::select_approx(size_type k, key_type & out)
+{
+	const jump_samples_ptr_type samples(myJumpIndex.load());
+
+	if (!samples || samples->empty()) {
+		return select(k, out);
+	}
+
+	const size_type entries(size());
+
+	if (!(k < entries)) {
+		return false;
+	}
+
+	// The segment past the last sample is answered with the last sample's key
+	const std::size_t segment((std::min)(samples->find_from_back(static_cast<std::ptrdiff_t>(entries - k)), samples->size() - 1));
+
+	out = (*samples)[segment].myKey;
+
+	return true;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::key_quantile(double q, key_type & out)
+{
+	static_assert(quantile_policy::Tracks_Quantiles, "key_quantile is only available with a quantile_policy that tracks");
+
+	return myQuantiles.quantile(q, out);
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::rebuild_quantiles()
+{
+	static_assert(quantile_policy::Tracks_Quantiles, "rebuild_quantiles is only available with a quantile_policy that tracks");
+
+	while (!myQuantiles.try_begin_rebuild()) {
+		std::this_thread::yield();
+	}
+
+	myQuantileWalk.reset();
+
+	redraw_quantiles();
+
+	myQuantiles.end_rebuild();
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::insert(const std::pair<key_type, value_type>& in)
+{
+	return insert(std::pair<key_type, value_type>(in));
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::insert(std::pair<key_type, value_type>&& in)
+{
+	shared_ptr_type entry(make_shared<node_type, allocator_type>(myAllocator, std::move(in)));
+
+	return insert_node(entry);
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::insert(const std::pair<key_type, value_type>& in, const time_point & deadline)
+{
+	return insert(std::pair<key_type, value_type>(in), deadline);
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::insert(std::pair<key_type, value_type>&& in, const time_point & deadline)
+{
+	static_assert(expiry_policy::Expires, "Deadlines are only available with an expiry_policy that expires");
+
+	shared_ptr_type entry(make_shared<node_type, allocator_type>(myAllocator, std::move(in)));
+	entry->myDeadline = deadline;
+
+	return insert_node(entry);
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::set_expiry_callback(expiry_callback_type callback)
+{
+	myExpiryCallback.set(std::move(callback));
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::insert_node(shared_ptr_type & entry)
+{
+	const key_type key(entry->myKeyValuePair.first);
+
+	if (!admit(key)) {
+		return false;
+	}
+
+	backoff_policy backoff;
+	std::size_t traversed(0);
+	std::size_t retries(0);
+
+	csldetail::insert_result result(csldetail::insert_result::Retry);
+	while ((result = try_insert(entry, traversed, nullptr)) == csldetail::insert_result::Retry) {
+		++retries;
+		backoff();
+	}
+
+	if (result == csldetail::insert_result::Rejected) {
+		return false;
+	}
+
+	mySize.add(1);
+
+	myStats.on_insert(traversed, retries);
+
+	count_key(key, 1);
+
+	bound_size(key);
+
+	maintain_index(traversed, std::integral_constant<bool, (0 < Jump_Index_Stride)>());
+
+	return true;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::try_pop(value_type & out)
+{
+	key_type dummy(0);
+	return try_pop_internal(dummy, out, false);
+}
+
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::try_pop(std::pair<key_type, value_type>& out)
+{
+	return try_pop_internal(out.first, out.second, false);
+}
+
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::compare_try_pop(std::pair<key_type, value_type>& out)
+{
+	return try_pop_internal(out.first, out.second, true);
+}
+
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::try_peek_top_key(key_type & out)
+{
+	if (traits_type::Publish_Top_Key) {
+		return myTopKey.read(out);
+	}
+
+	shared_ptr_type head(myFrontSentry.load());
+
+	// Batched pops leave deleted nodes in front of the top
+	while (Pop_Batch_Threshold && head) {
+		shared_ptr_type next(head->myNext.load());
+		if (!next.get_tag()) {
+			break;
+		}
+		next.clear_tag();
+		head = std::move(next);
+	}
+
+	if (!head) {
+		return false;
+	}
+
+	out = head->myKeyValuePair.first;
+
+	return true;
+}
+
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::unsafe_clear()
+{
+	myJumpIndex.unsafe_reset();
+
+	std::vector<node_type*> arr;
+	arr.reserve(size());
+
+	for (node_type* prev(static_cast<node_type*>(myFrontSentry)); prev; prev = static_cast<node_type*>(prev->myNext)) {
+		arr.push_back(prev);
+	}
+	for (typename std::vector<node_type*>::reverse_iterator it = arr.rbegin(); it != arr.rend(); ++it) {
+		(*it)->myNext.unsafe_store(nullptr);
+	}
+	myFrontSentry.unsafe_store(nullptr);
+	unsafe_publish_front();
+
+	mySize.unsafe_reset();
+	myConsumerPops.store(0, std::memory_order_relaxed);
+
+	myQuantiles.unsafe_reset();
+	myQuantileWalk.reset();
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::unsafe_insert(const std::pair<key_type, value_type>& in)
+{
+	return unsafe_insert(std::pair<key_type, value_type>(in));
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::unsafe_insert(std::pair<key_type, value_type>&& in)
+{
+	atomic_shared_ptr_type* const insertionPoint(unsafe_find_insertion_point(&myFrontSentry, in.first));
+
+	if (!insertionPoint) {
+		return false;
+	}
+
+	unsafe_link(*insertionPoint, make_shared<node_type, allocator_type>(myAllocator, std::move(in)));
+
+	return true;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::unsafe_try_pop(value_type & out)
+{
+	key_type dummy(0);
+	return unsafe_try_pop_internal(dummy, out);
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::unsafe_try_pop(std::pair<key_type, value_type>& out)
+{
+	return unsafe_try_pop_internal(out.first, out.second);
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+template<class InputIt>
+inline const typename concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::size_type concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::unsafe_insert_sorted(InputIt first, InputIt last)
+{
+	size_type inserted(0);
+
+	// Each search resumes after the previously inserted node
+	node_type* previous(nullptr);
+
+	typedef typename std::iterator_traits<InputIt>::reference reference;
+
+	for (; first != last; ++first) {
+		reference in(*first);
+
+		// Out of order entries are searched for from the front
+		if (previous && myComparator(in.first, previous->myKeyValuePair.first)) {
+			previous = nullptr;
+		}
+		else if (previous && !duplicate_policy::Allow_Duplicates && !myComparator(previous->myKeyValuePair.first, in.first)) {
+			continue;
+		}
+
+		atomic_shared_ptr_type* const insertionPoint(unsafe_find_insertion_point(previous ? &previous->myNext : &myFrontSentry, in.first));
+
+		if (!insertionPoint) {
+			continue;
+		}
+
+		shared_ptr_type entry(make_shared<node_type, allocator_type>(myAllocator, std::pair<key_type, value_type>(std::forward<reference>(in))));
+		previous = static_cast<node_type*>(entry);
+
+		unsafe_link(*insertionPoint, std::move(entry));
+
+		++inserted;
+	}
+
+	return inserted;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const typename concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::size_type concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::merge(concurrent_sorted_list && other)
+{
+	assert(&other != this && "Cannot merge a list into itself");
+
+	const bool moveNodes(myAllocator == other.myAllocator);
+
+	shared_ptr_type current(nullptr);
+
+	for (backoff_policy backoff;; backoff()) {
+		shared_ptr_type front(other.myFrontSentry.load());
+		if (!front || other.try_detach_after(front, current)) {
+			break;
+		}
+	}
+
+	// Samples of other would lead its inserts into the detached nodes
+	other.drop_index();
+	other.mySize.add(-static_cast<std::ptrdiff_t>(other.uncount(static_cast<node_type*>(current))));
+
+	size_type merged(0);
+
+	// Each search resumes after the previously merged node
+	shared_ptr_type previous(nullptr);
+
+	while (current) {
+		shared_ptr_type next(current->myNext.unsafe_exchange(nullptr));
+
+		// Popped from other, but never unlinked
+		if (next.get_tag()) {
+			next.clear_tag();
+			current = std::move(next);
+			continue;
+		}
+
+		shared_ptr_type entry(moveNodes ? current : make_shared<node_type, allocator_type>(myAllocator, std::move(current->myKeyValuePair)));
+		shared_ptr_type placed(entry);
+
+		// Copies keep the deadline of the original, if entries expire
+		if (!moveNodes) {
+			static_cast<typename expiry_policy::deadline_type&>(*static_cast<node_type*>(entry)) = *static_cast<node_type*>(current);
+		}
+
+		backoff_policy backoff;
+		std::size_t traversed(0);
+		std::size_t retries(0);
+
+		csldetail::insert_result result(csldetail::insert_result::Retry);
+		while ((result = try_insert(entry, traversed, previous ? &previous->myNext : nullptr)) == csldetail::insert_result::Retry) {
+			if (previous && previous->myNext.get_tag()) {
+				previous = shared_ptr_type(nullptr);
+			}
+			++retries;
+			backoff();
+		}
+
+		if (result == csldetail::insert_result::Inserted) {
+			mySize.add(1);
+			myStats.on_insert(traversed, retries);
+
+			count_key(placed->myKeyValuePair.first, 1);
+
+			bound_size(placed->myKeyValuePair.first);
+
+			previous = std::move(placed);
+			++merged;
+		}
+
+		current = std::move(next);
+	}
+
+	maintain_index(0, std::integral_constant<bool, (0 < Jump_Index_Stride)>());
+
+	return merged;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const typename concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::size_type concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::split_at(const key_type & key, concurrent_sorted_list & suffix)
+{
+	assert(&suffix != this && "Cannot split a list into itself");
+
+	suffix.unsafe_clear();
+	share_allocator(suffix, std::integral_constant<bool, Uses_Pool>());
+
+	backoff_policy backoff;
+
+	shared_ptr_type cut(nullptr);
+
+	for (;; backoff()) {
+		const jump_samples_ptr_type samples(myJumpIndex.load());
+
+		atomic_shared_ptr_type* link(nullptr);
+		shared_ptr_type last(nullptr);
+		shared_ptr_type current(nullptr);
+
+		if (!find_link(key, samples, link, last, current)) {
+			continue;
+		}
+		if (!current) {
+			return 0;
+		}
+
+		// Poppers that loaded the front node may tag it at any time, so the 
+		// cut is made behind it and the node itself claimed
+		if (link == &myFrontSentry) {
+			if (try_detach_after(current, cut)) {
+				break;
+			}
+			continue;
+		}
+
+		versioned_raw_ptr_type expected(current.get_versioned_raw_ptr());
+		if (exchange_link(*link, expected, shared_ptr_type(nullptr))) {
+			cut = std::move(current);
+			break;
+		}
+	}
+
+	// Samples past the cut would lead inserts into suffix
+	drop_index();
+
+	const size_type moved(uncount(static_cast<node_type*>(cut)));
+
+	mySize.add(-static_cast<std::ptrdiff_t>(moved));
+
+	suffix.myFrontSentry.unsafe_store(std::move(cut));
+	suffix.unlink_deleted_front();
+	suffix.unsafe_publish_front();
+	suffix.mySize.unsafe_add(static_cast<std::ptrdiff_t>(moved));
+	suffix.redraw_quantiles();
+
+	return moved;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const typename concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::size_type concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::erase_range(const key_type & lo, const key_type & hi)
+{
+	size_type erased(0);
+
+	backoff_policy backoff;
+
+	shared_ptr_type first(nullptr);
+	node_type* end(nullptr);
+
+	for (;; backoff()) {
+		const jump_samples_ptr_type samples(myJumpIndex.load());
+
+		atomic_shared_ptr_type* link(nullptr);
+		shared_ptr_type last(nullptr);
+		shared_ptr_type current(nullptr);
+
+		if (!find_link(lo, samples, link, last, current)) {
+			continue;
+		}
+
+		// Nodes tagged here are ours, as with pops. Tagged links also turn
+		// away inserts, so the segment cannot grow once marked
+		shared_ptr_type next(current);
+		while (next && myComparator(next->myKeyValuePair.first, hi)) {
+			shared_ptr_type after(next->myNext.load_and_tag());
+
+			if (!after.get_tag()) {
+				count_key(next->myKeyValuePair.first, -1);
+				++erased;
+			}
+			after.clear_tag();
+
+			next = std::move(after);
+		}
+
+		// Possibly unlinked already, by inserts or pops passing by
+		if (static_cast<node_type*>(current) == static_cast<node_type*>(next)) {
+			break;
+		}
+
+		end = static_cast<node_type*>(next);
+
+		versioned_raw_ptr_type expected(current.get_versioned_raw_ptr());
+		if (exchange_link(*link, expected, std::move(next))) {
+			first = std::move(current);
+			break;
+		}
+	}
+
+	release_run(std::move(first), end);
+
+	mySize.add(-static_cast<std::ptrdiff_t>(erased));
+
+	return erased;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const typename concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::stats_policy & concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::get_stats() const
+{
+	return myStats;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline typename concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::pool_type & concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::global_pool()
+{
+	return csldetail::global_node_pool<alloc_type>(traits_type::Pool_Block_Size);
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline typename concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::allocator_type concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::default_allocator(std::true_type)
+{
+	if (traits_type::Use_Global_Pool) {
+		return allocator_type(&global_pool());
+	}
+
+	myOwnedPool.reset(new pool_type(traits_type::Pool_Block_Size));
+
+	return allocator_type(myOwnedPool.get());
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline typename concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::allocator_type concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::default_allocator(std::false_type)
+{
+	return allocator_type();
+}
+
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const csldetail::insert_result concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::try_insert(shared_ptr_type& entry, std::size_t& traversed, atomic_shared_ptr_type* from)
+{
+	// Keeps the sample nodes referenced for the duration of the attempt
+	const jump_samples_ptr_type samples(from ? jump_samples_ptr_type(nullptr) : myJumpIndex.load());
+
+	shared_ptr_type last(nullptr);
+
+	const std::size_t segment(jump_segment(samples, entry->myKeyValuePair.first));
+
+	atomic_shared_ptr_type* insertionPoint(from ? from : jump_start(samples, segment));
+
+	shared_ptr_type current(insertionPoint->load());
+
+	// The starting node has been popped since
+	if (current.get_tag()) {
+		return csldetail::insert_result::Retry;
+	}
+
+	const time_point now(expiry_policy::now());
+
+	// The first of the deleted nodes stepped over since insertionPoint
+	versioned_raw_ptr_type skipped(nullptr);
+
+	while (current) {
+		if (myComparator(entry->myKeyValuePair.first, current->myKeyValuePair.first)) {
+			break;
+		}
+
+		shared_ptr_type next(current->myNext.load());
+
+		prefetch_ahead(static_cast<node_type*>(next));
+
+		if (!next.get_tag() && current->expired(now)) {
+			next = expire(static_cast<node_type*>(current));
+		}
+
+		// Stepped over and left linked, to be unlinked together along with 
+		// the link to entry should it land right behind them
+		if (Pop_Batch_Threshold && next.get_tag()) {
+			if (!skipped) {
+				skipped = current.get_versioned_raw_ptr();
+			}
+			next.clear_tag();
+			current = std::move(next);
+		}
+		else if (next.get_tag()) {
+			next.clear_tag();
+
+			versioned_raw_ptr_type expected(current.get_versioned_raw_ptr());
+			if (exchange_link(*insertionPoint, expected, std::move(next))) {
+				shared_ptr_type null(nullptr);
+				null.set_tag();
+				current->myNext.store(null);
+			}
+
+			current = insertionPoint->load();
+
+			if (current.get_tag()) {
+				return csldetail::insert_result::Retry;
+			}
+		}
+		else {
+			if (!duplicate_policy::Allow_Duplicates && !myComparator(current->myKeyValuePair.first, entry->myKeyValuePair.first)) {
+				return csldetail::insert_result::Rejected;
+			}
+			++traversed;
+
+			last = std::move(current);
+			current = std::move(next);
+			insertionPoint = &last->myNext;
+			skipped = versioned_raw_ptr_type(nullptr);
+		}
+	};
+
+	versioned_raw_ptr_type expected(skipped ? skipped : current.get_versioned_raw_ptr());
+	entry->myNext.unsafe_store(std::move(current));
+
+	if (exchange_link(*insertionPoint, expected, std::move(entry))) {
+		if (Jump_Index_Counts && samples) {
+			samples->add_weight(segment, 1);
+		}
+		return csldetail::insert_result::Inserted;
+	}
+
+	return csldetail::insert_result::Retry;
+}
+
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::try_pop_internal(key_type & expectedKey, value_type & outValue, const bool matchKey)
+{
+	if (Pop_Batch_Threshold) {
+		return try_pop_batched(expectedKey, outValue, matchKey);
+	}
+	if (traits_type::Single_Consumer) {
+		return try_pop_single(expectedKey, outValue, matchKey);
+	}
+
+	const bool reserves(size_policy::Reserve_On_Pop);
+
+	if (reserves && !mySize.try_reserve()) {
+		myStats.on_failed_pop();
+		return false;
+	}
+
+	shared_ptr_type head(nullptr);
+	shared_ptr_type splice(nullptr);
+
+	versioned_raw_ptr_type expected(nullptr);
+
+	backoff_policy backoff;
+	std::size_t retries(0);
+
+	const time_point now(expiry_policy::now());
+
+	for (;;) {
+		head = myFrontSentry.load();
+
+		if (!head) {
+			if (reserves) {
+				mySize.add(1);
+			}
+			myStats.on_failed_pop();
+			return false;
+		}
+
+		const bool expired(head->expired(now));
+
+		const key_type key(head->myKeyValuePair.first);
+		if (!expired && (matchKey & (expectedKey != key))) {
+			if (reserves) {
+				mySize.add(1);
+			}
+			expectedKey = key;
+			return false;
+		}
+
+		splice = head->myNext.load_and_tag();
+		const bool mine(!splice.get_tag());
+		splice.clear_tag();
+
+		if (unlink_front(head, std::move(splice))) {
+			unlink_deleted_front();
+		}
+
+		if (mine && !expired) {
+			break;
+		}
+
+		// Counted apart from the reservation, which still stands
+		if (mine) {
+			on_expired(static_cast<node_type*>(head));
+			continue;
+		}
+
+		++retries;
+		backoff();
+	}
+	if (!reserves) {
+		mySize.add(-1);
+	}
+
+	count_key(head->myKeyValuePair.first, -1);
+
+	expectedKey = head->myKeyValuePair.first;
+	head->read_value(outValue);
+
+	myStats.on_pop(retries);
+
+	return true;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::try_pop_single(key_type & expectedKey, value_type & outValue, const bool matchKey)
+{
+	const time_point now(expiry_policy::now());
+
+	std::size_t retries(0);
+
+	for (;;) {
+		shared_ptr_type head(myFrontSentry.load());
+
+		if (!head) {
+			myStats.on_failed_pop();
+			return false;
+		}
+
+		const bool expired(head->expired(now));
+
+		const key_type key(head->myKeyValuePair.first);
+		if (!expired && (matchKey & (expectedKey != key))) {
+			expectedKey = key;
+			return false;
+		}
+
+		// No other popper takes head, but inserts linking in behind it must 
+		// fail from here on
+		shared_ptr_type splice(head->myNext.load_and_tag());
+		const bool mine(!splice.get_tag());
+		splice.clear_tag();
+
+		if (unlink_front(head, std::move(splice))) {
+			unlink_deleted_front();
+		}
+
+		if (mine && !expired) {
+			myConsumerPops.store(myConsumerPops.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+			count_key(key, -1);
+
+			expectedKey = key;
+			head->read_value(outValue);
+
+			myStats.on_pop(retries);
+
+			return true;
+		}
+
+		if (mine) {
+			on_expired(static_cast<node_type*>(head));
+			continue;
+		}
+
+		// Erased or evicted ahead of us
+		++retries;
+	}
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::try_pop_batched(key_type & expectedKey, value_type & outValue, const bool matchKey)
+{
+	const bool reserves(size_policy::Reserve_On_Pop);
+
+	if (reserves && !mySize.try_reserve()) {
+		myStats.on_failed_pop();
+		return false;
+	}
+
+	backoff_policy backoff;
+	std::size_t retries(0);
+
+	const time_point now(expiry_policy::now());
+
+	shared_ptr_type head(myFrontSentry.load());
+	shared_ptr_type current(head);
+	shared_ptr_type next(nullptr);
+
+	// Deleted nodes walked past from head, counting the one taken
+	std::size_t deleted(0);
+
+	for (;;) {
+		if (!current) {
+
+			// Everything from head on was taken, unless head has been unlinked 
+			// meanwhile and the walk cut short
+			const shared_ptr_type front(myFrontSentry.load());
+			if (front == head) {
+				if (reserves) {
+					mySize.add(1);
+				}
+				myStats.on_failed_pop();
+				return false;
+			}
+
+			head = front;
+			current = head;
+			deleted = 0;
+
+			++retries;
+			backoff();
+			continue;
+		}
+
+		if (current->myNext.get_tag()) {
+			next = current->myNext.load();
+			next.clear_tag();
+			current = std::move(next);
+			++deleted;
+			continue;
+		}
+
+		const bool expired(current->expired(now));
+
+		const key_type key(current->myKeyValuePair.first);
+		if (!expired && (matchKey & (expectedKey != key))) {
+			if (reserves) {
+				mySize.add(1);
+			}
+			expectedKey = key;
+			return false;
+		}
+
+		// Lost to another pop, which leaves current to be walked past
+		next = current->myNext.load_and_tag();
+		if (next.get_tag()) {
+			++retries;
+			continue;
+		}
+
+		++deleted;
+
+		// Counted apart from the reservation, which still stands
+		if (expired) {
+			on_expired(static_cast<node_type*>(current));
+			current = std::move(next);
+			continue;
+		}
+		break;
+	}
+
+	if (!(deleted < Pop_Batch_Threshold)) {
+		versioned_raw_ptr_type expected(head.get_versioned_raw_ptr());
+		if (exchange_front(expected, shared_ptr_type(next))) {
+			release_run(std::move(head), static_cast<node_type*>(next));
+		}
+
+		// An insert may have landed ahead of the batch, leaving it in mid list
+		else {
+			unlink_deleted_through(current->myKeyValuePair.first);
+		}
+	}
+
+	if (!reserves) {
+		mySize.add(-1);
+	}
+
+	count_key(current->myKeyValuePair.first, -1);
+
+	expectedKey = current->myKeyValuePair.first;
+	current->read_value(outValue);
+
+	myStats.on_pop(retries);
+
+	return true;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::unsafe_try_pop_internal(key_type & outKey, value_type & outValue)
+{
+	for (node_type* head(static_cast<node_type*>(myFrontSentry)); head; head = static_cast<node_type*>(myFrontSentry)) {
+
+		// Popped, but not unlinked, during a concurrent phase
+		if (head->myNext.get_tag()) {
+			unsafe_unlink(myFrontSentry, head);
+			continue;
+		}
+
+		outKey = head->myKeyValuePair.first;
+		head->read_value(outValue);
+
+		unsafe_unlink(myFrontSentry, head);
+
+		mySize.unsafe_add(-1);
+
+		count_key(outKey, -1);
+
+		return true;
+	}
+
+	return false;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline typename concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::atomic_shared_ptr_type * concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::unsafe_find_insertion_point(atomic_shared_ptr_type * from, const key_type & key)
+{
+	atomic_shared_ptr_type* insertionPoint(from);
+
+	for (node_type* current(static_cast<node_type*>(*insertionPoint)); current; current = static_cast<node_type*>(*insertionPoint)) {
+		if (current->myNext.get_tag()) {
+			unsafe_unlink(*insertionPoint, current);
+			continue;
+		}
+		if (myComparator(key, current->myKeyValuePair.first)) {
+			break;
+		}
+		if (!duplicate_policy::Allow_Duplicates && !myComparator(current->myKeyValuePair.first, key)) {
+			return nullptr;
+		}
+
+		prefetch_ahead(static_cast<node_type*>(current->myNext));
+
+		insertionPoint = &current->myNext;
+	}
+
+	return insertionPoint;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::unsafe_link(atomic_shared_ptr_type & at, shared_ptr_type && entry)
+{
+	node_type* const node(static_cast<node_type*>(entry));
+
+	node->myNext.unsafe_store(at.unsafe_exchange(std::move(entry)));
+
+	if (&at == &myFrontSentry) {
+		unsafe_publish_front();
+	}
+
+	mySize.unsafe_add(1);
+
+	count_key(node->myKeyValuePair.first, 1);
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::unsafe_unlink(atomic_shared_ptr_type & at, node_type * node)
+{
+	shared_ptr_type null(nullptr);
+	null.set_tag();
+
+	shared_ptr_type next(node->myNext.unsafe_exchange(std::move(null)));
+	next.clear_tag();
+
+	at.unsafe_store(std::move(next));
+
+	if (&at == &myFrontSentry) {
+		unsafe_publish_front();
+	}
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::exchange_link(atomic_shared_ptr_type & link, versioned_raw_ptr_type & expected, shared_ptr_type && desired)
+{
+	if (&link == &myFrontSentry) {
+		return exchange_front(expected, std::move(desired));
+	}
+	return link.compare_exchange_strong(expected, std::move(desired));
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::exchange_front(versioned_raw_ptr_type & expected, shared_ptr_type && desired)
+{
+	if (!myFrontSentry.compare_exchange_strong(expected, std::move(desired))) {
+		return false;
+	}
+
+	if (traits_type::Publish_Top_Key) {
+		publish_front();
+	}
+
+	myFrontSignal.raise();
+
+	return true;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::publish_front()
+{
+	myTopKey.mark_stale();
+
+	while (myTopKey.try_begin_publish()) {
+		const shared_ptr_type front(myFrontSentry.load());
+
+		myTopKey.end_publish(front ? front->myKeyValuePair.first : key_type(0), !front);
+
+		// Front changes made while publishing were left to us
+		if (!myTopKey.is_stale()) {
+			break;
+		}
+	}
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::unlink_front(shared_ptr_type & head, shared_ptr_type && next)
+{
+	node_type* const headNode(static_cast<node_type*>(head));
+	node_type* const nextNode(static_cast<node_type*>(next));
+
+	versioned_raw_ptr_type expected(head.get_versioned_raw_ptr());
+	while (!exchange_front(expected, std::move(next))) {
+		if (static_cast<node_type*>(expected) != headNode) {
+
+			// Either unlinked already, or an insert landed ahead of head
+			unlink_deleted_through(headNode->myKeyValuePair.first);
+			return false;
+		}
+	}
+
+	// Still referenced through head
+	const bool nextDeleted(nextNode && nextNode->myNext.get_tag());
+
+	shared_ptr_type null(nullptr);
+	null.set_tag();
+	headNode->myNext.store(null);
+
+	return nextDeleted;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::try_detach_after(shared_ptr_type & head, shared_ptr_type & chain)
+{
+	node_type* const headNode(static_cast<node_type*>(head));
+
+	shared_ptr_type next(headNode->myNext.load());
+	if (next.get_tag()) {
+		return false;
+	}
+
+	versioned_raw_ptr_type expected(next.get_versioned_raw_ptr());
+	if (!headNode->myNext.compare_exchange_strong(expected, shared_ptr_type(nullptr))) {
+		return false;
+	}
+
+	chain = std::move(next);
+
+	shared_ptr_type splice(headNode->myNext.load_and_tag());
+	if (splice.get_tag()) {
+		return true;
+	}
+
+	// Copied, since readers of head may still be at it
+	shared_ptr_type carried(make_shared<node_type, allocator_type>(myAllocator, std::pair<key_type, value_type>(headNode->myKeyValuePair)));
+	static_cast<typename expiry_policy::deadline_type&>(*static_cast<node_type*>(carried)) = *headNode;
+
+	carried->myNext.unsafe_store(std::move(chain));
+	chain = std::move(carried);
+
+	if (unlink_front(head, std::move(splice))) {
+		unlink_deleted_front();
+	}
+
+	return true;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const typename concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::size_type concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::uncount(node_type * first)
+{
+	size_type uncounted(0);
+
+	for (node_type* node(first); node; node = static_cast<node_type*>(node->myNext)) {
+		if (!node->myNext.get_tag()) {
+			count_key(node->myKeyValuePair.first, -1);
+			++uncounted;
+		}
+	}
+
+	return uncounted;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::unlink_deleted_front()
+{
+	for (shared_ptr_type front(myFrontSentry.load()); front && front->myNext.get_tag(); front = myFrontSentry.load()) {
+		unlink_deleted(myFrontSentry);
+	}
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::unlink_deleted(atomic_shared_ptr_type & link)
+{
+	shared_ptr_type first(link.load());
+
+	if (first.get_tag()) {
+		return false;
+	}
+
+	shared_ptr_type end(first);
+	while (end && end->myNext.get_tag()) {
+		shared_ptr_type next(end->myNext.load());
+		next.clear_tag();
+		end = std::move(next);
+	}
+
+	if (first == end) {
+		return true;
+	}
+
+	versioned_raw_ptr_type expected(first.get_versioned_raw_ptr());
+	if (exchange_link(link, expected, shared_ptr_type(end))) {
+		release_run(std::move(first), static_cast<node_type*>(end));
+	}
+
+	return true;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::release_run(shared_ptr_type first, const node_type * end)
+{
+	// Holding on to each successor before cutting it loose keeps the nodes 
+	// from being released recursively
+	shared_ptr_type null(nullptr);
+	null.set_tag();
+
+	while (first && static_cast<node_type*>(first) != end) {
+		shared_ptr_type next(first->myNext.load());
+		next.clear_tag();
+
+		first->myNext.store(null);
+		first = std::move(next);
+	}
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::unlink_deleted_through(const key_type & key)
+{
+	backoff_policy backoff;
+
+	for (;; backoff()) {
+		atomic_shared_ptr_type* link(&myFrontSentry);
+		shared_ptr_type last(nullptr);
+		shared_ptr_type current(myFrontSentry.load());
+
+		// Cleared should a predecessor be deleted on the way
+		bool linked(true);
+
+		while (linked && current && !myComparator(key, current->myKeyValuePair.first)) {
+			if (current->myNext.get_tag()) {
+				linked = unlink_deleted(*link);
+				current = link->load();
+				linked &= !current.get_tag();
+				continue;
+			}
+
+			shared_ptr_type next(current->myNext.load());
+			if (next.get_tag()) {
+				continue;
+			}
+
+			last = std::move(current);
+			current = std::move(next);
+			link = &last->myNext;
+		}
+
+		if (linked) {
+			return;
+		}
+	}
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::rebuild_index()
+{
+	static_assert(0 < Jump_Index_Stride, "rebuild_index is only available with Jump_Index_Stride");
+
+	while (!myJumpIndex.try_begin_rebuild()) {
+		std::this_thread::yield();
+	}
+
+	myJumpIndex.abandon_rebuild();
+	myJumpIndex.rebuild_step(myFrontSentry, Jump_Index_Stride, size(), std::numeric_limits<std::size_t>::max());
+	myJumpIndex.end_rebuild();
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::indexed() const
+{
+	return myJumpIndex.has_samples();
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::maintain_index(std::size_t /*traversed*/, std::false_type)
+{
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::maintain_index(std::size_t traversed, std::true_type)
+{
+	const bool hasSamples(myJumpIndex.has_samples());
+
+	// Short walks through an index on a list that has since shrunk
+	if (Jump_Index_Min_Size && hasSamples && traversed < Jump_Index_Stride && size() < Jump_Index_Min_Size) {
+		if (myJumpIndex.try_begin_rebuild()) {
+			myJumpIndex.abandon_rebuild();
+			myJumpIndex.store(jump_samples_ptr_type(nullptr));
+			myJumpIndex.end_rebuild();
+		}
+		return;
+	}
+
+	// A missing index is only worth building once walks get longer than
+	// Jump_Index_Min_Size, a present one whenever it is stale
+	const std::size_t threshold(hasSamples ? Jump_Index_Stride * 2 : (std::max)(Jump_Index_Stride * 2, Jump_Index_Min_Size));
+
+	if (!(threshold < traversed) && !myJumpIndex.rebuilding()) {
+		return;
+	}
+	if (!myJumpIndex.try_begin_rebuild()) {
+		return;
+	}
+
+	const std::size_t step(Jump_Index_Rebuild_Step ? Jump_Index_Rebuild_Step : std::numeric_limits<std::size_t>::max());
+
+	myJumpIndex.rebuild_step(myFrontSentry, Jump_Index_Stride, size(), step);
+	myJumpIndex.end_rebuild();
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::drop_index()
+{
+	if (!Jump_Index_Stride) {
+		return;
+	}
+
+	while (!myJumpIndex.try_begin_rebuild()) {
+		std::this_thread::yield();
+	}
+
+	myJumpIndex.abandon_rebuild();
+	myJumpIndex.store(jump_samples_ptr_type(nullptr));
+	myJumpIndex.end_rebuild();
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::share_allocator(concurrent_sorted_list& with, std::true_type)
+{
+	with.myOwnedPool = myOwnedPool;
+	with.myAllocator = myAllocator;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::share_allocator(concurrent_sorted_list& /*with*/, std::false_type)
+{
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::admit(const key_type & key) const
+{
+	if (!Capacity || size() < Capacity) {
+		return true;
+	}
+
+	return myComparator(key, myTailKey.load(std::memory_order_relaxed));
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::bound_size(const key_type & inserted)
+{
+	if (!Capacity) {
+		return;
+	}
+
+	if (Capacity < size()) {
+		evict_tail();
+		return;
+	}
+
+	key_type tail(myTailKey.load(std::memory_order_relaxed));
+	while (myComparator(tail, inserted) && !myTailKey.compare_exchange_weak(tail, inserted, std::memory_order_relaxed));
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::evict_tail()
+{
+	shared_ptr_type null(nullptr);
+	null.set_tag();
+
+	backoff_policy backoff;
+
+	bool useSamples(true);
+
+	for (;; backoff()) {
+		const jump_samples_ptr_type samples(useSamples ? myJumpIndex.load() : jump_samples_ptr_type(nullptr));
+
+		atomic_shared_ptr_type* link(&myFrontSentry);
+		key_type lastKey((std::numeric_limits<key_type>::max)());
+
+		// Starts from the next to last live sample, since the last may be the tail
+		if (samples) {
+			bool skipped(false);
+			for (typename jump_index_type::samples_type::const_reverse_iterator it(samples->rbegin()); it != samples->rend(); ++it) {
+				if (it->myNode->myNext.get_tag()) {
+					continue;
+				}
+				if (!skipped) {
+					skipped = true;
+					continue;
+				}
+				link = &it->myNode->myNext;
+				lastKey = it->myKey;
+				break;
+			}
+		}
+
+		shared_ptr_type last(nullptr);
+		shared_ptr_type current(link->load());
+
+		if (current.get_tag()) {
+			continue;
+		}
+
+		versioned_raw_ptr_type end(nullptr);
+
+		while (current) {
+			shared_ptr_type next(current->myNext.load());
+
+			if (next.get_tag()) {
+				next.clear_tag();
+
+				versioned_raw_ptr_type expected(current.get_versioned_raw_ptr());
+				if (exchange_link(*link, expected, std::move(next))) {
+					current->myNext.store(null);
+				}
+
+				current = link->load();
+
+				if (current.get_tag()) {
+					break;
+				}
+				continue;
+			}
+
+			if (!next) {
+				end = next.get_versioned_raw_ptr();
+				break;
+			}
+
+			lastKey = current->myKeyValuePair.first;
+			last = std::move(current);
+			current = std::move(next);
+			link = &last->myNext;
+		}
+
+		if (!current || current.get_tag()) {
+			if (link == &myFrontSentry && !current) {
+				return;
+			}
+
+			// Ran out of list at the starting sample
+			useSamples &= !(!last && !current);
+			continue;
+		}
+
+		// Claimed only while still last, so that appended entries stay
+		if (!current->myNext.compare_exchange_strong(end, shared_ptr_type(null))) {
+			continue;
+		}
+
+		mySize.add(-1);
+
+		count_key(current->myKeyValuePair.first, -1);
+
+		if (Jump_Index_Counts && samples) {
+			samples->add_weight(jump_segment(samples, current->myKeyValuePair.first), -1);
+		}
+
+		versioned_raw_ptr_type expected(current.get_versioned_raw_ptr());
+		exchange_link(*link, expected, shared_ptr_type(nullptr));
+
+		myTailKey.store(lastKey, std::memory_order_relaxed);
+
+		return;
+	}
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::count_key(const key_type & key, std::ptrdiff_t delta)
+{
+	// Every operation takes a step once a walk is under way, keeping the 
+	// entries it misses behind it few
+	if ((myQuantiles.add(key, delta, myComparator) || myQuantileWalk.active()) && myQuantiles.try_begin_rebuild()) {
+		step_quantile_walk(std::integral_constant<bool, quantile_policy::Tracks_Quantiles>());
+		myQuantiles.end_rebuild();
+	}
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::redraw_quantiles()
+{
+	if (!quantile_policy::Tracks_Quantiles) {
+		return;
+	}
+
+	const time_point now(expiry_policy::now());
+
+	std::vector<key_type> keys;
+	keys.reserve(size());
+
+	for (shared_ptr_type current(myFrontSentry.load()); current; current = current->myNext.load()) {
+		if (!current->myNext.get_tag() && !current->expired(now)) {
+			keys.push_back(current->myKeyValuePair.first);
+		}
+	}
+
+	myQuantiles.rebuild(keys, myComparator);
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::step_quantile_walk(std::true_type)
+{
+	csldetail::quantile_walk<key_type, shared_ptr_type, true>& walk(myQuantileWalk);
+
+	if (!walk.active()) {
+		walk.myActive.store(true, std::memory_order_relaxed);
+		walk.myCursor = myFrontSentry.load();
+	}
+
+	const time_point now(expiry_policy::now());
+
+	for (std::size_t visited = 0; walk.myCursor && visited < Quantile_Walk_Step; ++visited) {
+		shared_ptr_type next(walk.myCursor->myNext.load());
+
+		// Deleted since the walk got here, and possibly cut loose. Picks up 
+		// again after the last key taken
+		if (next.get_tag()) {
+			if (walk.myKeys.empty()) {
+				walk.myCursor = myFrontSentry.load();
+				continue;
+			}
+
+			const jump_samples_ptr_type samples(myJumpIndex.load());
+			walk.myCursor = jump_start(samples, jump_segment(samples, walk.myKeys.back()))->load();
+			walk.myCursor.clear_tag();
+			continue;
+		}
+
+		const key_type& key(walk.myCursor->myKeyValuePair.first);
+
+		// Keys behind the last taken were passed over before picking up again
+		if (!walk.myCursor->expired(now) && (walk.myKeys.empty() || !myComparator(key, walk.myKeys.back()))) {
+			walk.myKeys.push_back(key);
+		}
+
+		walk.myCursor = std::move(next);
+	}
+
+	if (walk.myCursor) {
+		return;
+	}
+
+	myQuantiles.rebuild(walk.myKeys, myComparator);
+
+	walk.reset();
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::step_quantile_walk(std::false_type)
+{
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline typename concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::shared_ptr_type concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::expire(node_type * node)
+{
+	shared_ptr_type next(node->myNext.load_and_tag());
+
+	if (!next.get_tag()) {
+		on_expired(node);
+		next.set_tag();
+	}
+
+	return next;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::on_expired(node_type * node)
+{
+	mySize.add(-1);
+
+	count_key(node->myKeyValuePair.first, -1);
+
+	myExpiryCallback(node->myKeyValuePair.first, node->myKeyValuePair.second);
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline typename concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::atomic_shared_ptr_type * concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::jump_start(const jump_samples_ptr_type & samples, std::size_t segment)
+{
+	if (!samples) {
+		return &myFrontSentry;
+	}
+
+	// A sample that is not tagged deleted is still linked
+	while (segment) {
+		--segment;
+
+		node_type* const node((*samples)[segment].myNode);
+		if (!node->myNext.get_tag()) {
+			return &node->myNext;
+		}
+	}
+
+	return &myFrontSentry;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const std::size_t concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::jump_segment(const jump_samples_ptr_type & samples, const key_type & key) const
+{
+	if (!samples) {
+		return 0;
+	}
+
+	typedef typename jump_index_type::sample_type sample_type;
+
+	const comparator_type& comparator(myComparator);
+	typename jump_index_type::samples_type::const_iterator it(std::lower_bound(samples->begin(), samples->end(), key, [&comparator](const sample_type& sample, const key_type& key) {
+		return comparator(sample.myKey, key);
+	}));
+
+	return static_cast<std::size_t>(it - samples->begin());
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::find_link(const key_type & key, const jump_samples_ptr_type & samples, atomic_shared_ptr_type *& link, shared_ptr_type & last, shared_ptr_type & current)
+{
+	link = jump_start(samples, jump_segment(samples, key));
+	last = shared_ptr_type(nullptr);
+	current = link->load();
+
+	// The starting node has been popped since
+	if (current.get_tag()) {
+		return false;
+	}
+
+	while (current) {
+
+		// Not left for pops to come, which may be racing inserts ahead of it
+		if (current->myNext.get_tag()) {
+			if (!unlink_deleted(*link)) {
+				return false;
+			}
+
+			current = link->load();
+			if (current.get_tag()) {
+				return false;
+			}
+			continue;
+		}
+
+		if (!myComparator(current->myKeyValuePair.first, key)) {
+			break;
+		}
 
 		shared_ptr_type next(current->myNext.load());
+		if (next.get_tag()) {
+			continue;
+		}
+
+		last = std::move(current);
+		current = std::move(next);
+		link = &last->myNext;
+	}
+
+	return true;
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::prefetch_ahead(node_type * next)
+{
+	if (!Prefetch_Distance || !next) {
+		return;
+	}
+
+	// next is referenced by the caller, so its link may be read. The node 
+	// beyond is only prefetched, which is harmless should it be gone
+	csldetail::prefetch(Prefetch_Distance == 1 ? next : static_cast<node_type*>(next->myNext));
+}
+template<class KeyType, class ValueType, class Comparator, class Traits>
+inline void concurrent_sorted_list<KeyType, ValueType, Comparator, Traits>::unsafe_publish_front()
+{
+	node_type* const front(static_cast<node_type*>(myFrontSentry));
+
+	myTopKey.unsafe_publish(front ? front->myKeyValuePair.first : key_type(0), !front);
+
+	myFrontSignal.raise();
+}
+namespace csldetail
+{
+struct no_deadline
+{
+	template <class TimePoint>
+	const bool expired(const TimePoint& /*now*/) const { return false; }
+};
+template <class TimePoint>
+struct deadline
+{
+	const bool expired(const TimePoint& now) const { return !(now < myDeadline); }
+
+	TimePoint myDeadline = (TimePoint::max)();
+};
+template <class KeyType, class ValueType, bool Enabled>
+class expiry_callback
+{
+public:
+	typedef std::function<void(const KeyType&, ValueType&)> function_type;
+
+	void set(function_type&& function) { myFunction = std::move(function); }
+	void operator()(const KeyType& key, ValueType& value) const
+	{
+		if (myFunction) {
+			myFunction(key, value);
+		}
+	}
+
+private:
+	function_type myFunction;
+};
+template <class KeyType, class ValueType>
+class expiry_callback<KeyType, ValueType, false>
+{
+public:
+	typedef std::function<void(const KeyType&, ValueType&)> function_type;
+
+	void set(function_type&&) {}
+	void operator()(const KeyType&, ValueType&) const {}
+};
+
+// The deadline base is empty unless entries expire
+template <class KeyType, class ValueType, class Allocator, class Reclamation, class Deadline>
+class node : public Deadline
+{
+public:
+	typedef KeyType key_type;
+	typedef ValueType value_type;
+	typedef typename Reclamation::template atomic_shared_ptr_type<node, Allocator> atomic_shared_ptr_type;
+
+	// Trivially copyable entries skip construction altogether. Storage stays
+	// untouched until copied into bytewise, and no default constructor is needed
+	static constexpr bool Trivial_Entry = std::is_trivially_copyable<key_type>::value && std::is_trivially_copyable<value_type>::value;
+
+	node(std::pair<key_type, value_type>&& in);
+	~node();
+
+	void read_value(value_type& out) const;
+
+	union
+	{
+		std::pair<key_type, value_type> myKeyValuePair;
+	};
+	atomic_shared_ptr_type myNext;
+
+private:
+	void construct(std::pair<key_type, value_type>&& in, std::true_type);
+	void construct(std::pair<key_type, value_type>&& in, std::false_type);
+
+	void destroy(std::true_type);
+	void destroy(std::false_type);
+
+	void read_value(value_type& out, std::true_type) const;
+	void read_value(value_type& out, std::false_type) const;
+};
+template<class KeyType, class ValueType, class Allocator, class Reclamation, class Deadline>
+inline node<KeyType, ValueType, Allocator, Reclamation, Deadline>::node(std::pair<key_type, value_type>&& in)
+	: myNext(nullptr)
+{
+	construct(std::move(in), std::integral_constant<bool, Trivial_Entry>());
+}
+template<class KeyType, class ValueType, class Allocator, class Reclamation, class Deadline>
+inline node<KeyType, ValueType, Allocator, Reclamation, Deadline>::~node()
+{
+	destroy(std::integral_constant<bool, Trivial_Entry>());
+}
+template<class KeyType, class ValueType, class Allocator, class Reclamation, class Deadline>
+inline void node<KeyType, ValueType, Allocator, Reclamation, Deadline>::read_value(value_type & out) const
+{
+	read_value(out, std::integral_constant<bool, Trivial_Entry>());
+}
+template<class KeyType, class ValueType, class Allocator, class Reclamation, class Deadline>
+inline void node<KeyType, ValueType, Allocator, Reclamation, Deadline>::construct(std::pair<key_type, value_type>&& in, std::true_type)
+{
+	std::memcpy(&myKeyValuePair.first, &in.first, sizeof(key_type));
+	std::memcpy(&myKeyValuePair.second, &in.second, sizeof(value_type));
+}
+template<class KeyType, class ValueType, class Allocator, class Reclamation, class Deadline>
+inline void node<KeyType, ValueType, Allocator, Reclamation, Deadline>::construct(std::pair<key_type, value_type>&& in, std::false_type)
+{
+	new (&myKeyValuePair) std::pair<key_type, value_type>(std::move(in));
+}
+template<class KeyType, class ValueType, class Allocator, class Reclamation, class Deadline>
+inline void node<KeyType, ValueType, Allocator, Reclamation, Deadline>::destroy(std::true_type)
+{
+}
+template<class KeyType, class ValueType, class Allocator, class Reclamation, class Deadline>
+inline void node<KeyType, ValueType, Allocator, Reclamation, Deadline>::destroy(std::false_type)
+{
+	myKeyValuePair.~pair();
+}
+template<class KeyType, class ValueType, class Allocator, class Reclamation, class Deadline>
+inline void node<KeyType, ValueType, Allocator, Reclamation, Deadline>::read_value(value_type & out, std::true_type) const
+{
+	std::memcpy(&out, &myKeyValuePair.second, sizeof(value_type));
+}
+template<class KeyType, class ValueType, class Allocator, class Reclamation, class Deadline>
+inline void node<KeyType, ValueType, Allocator, Reclamation, Deadline>::read_value(value_type & out, std::false_type) const
+{
+	out = myKeyValuePair.second;
+}
+template <class KeyType, std::size_t CacheLineSize, bool Enabled>
+class top_key_cache
+{
+public:
+	top_key_cache();
+
+	// Flags the published key as out of date
+	void mark_stale();
+	const bool is_stale() const;
+
+	// Acquires the right to publish and clears the stale flag. Fails if 
+	// another thread is publishing
+	const bool try_begin_publish();
+	void end_publish(const KeyType key, const bool empty);
+
+	void unsafe_publish(const KeyType key, const bool empty);
+
+	// Returns false if the front was empty
+	const bool read(KeyType& out) const;
+
+private:
+	CSL_PADD(CacheLineSize);
+
+	// Odd while publishing
+	std::atomic<uint32_t> mySequence;
+	std::atomic<bool> myStale;
+	std::atomic<bool> myEmpty;
+	std::atomic<KeyType> myKey;
+	CSL_PADD(CacheLineSize - ((sizeof(std::atomic<uint32_t>) + sizeof(std::atomic<bool>) * 2 + sizeof(std::atomic<KeyType>)) % CacheLineSize));
+};
+template <class KeyType, std::size_t CacheLineSize>
+class top_key_cache<KeyType, CacheLineSize, false>
+{
+public:
+	void mark_stale() {}
+	const bool is_stale() const { return false; }
+	const bool try_begin_publish() { return false; }
+	void end_publish(const KeyType, const bool) {}
+	void unsafe_publish(const KeyType, const bool) {}
+	const bool read(KeyType&) const { return false; }
+};
+template<class KeyType, std::size_t CacheLineSize, bool Enabled>
+inline top_key_cache<KeyType, CacheLineSize, Enabled>::top_key_cache()
+	: mySequence(0)
+	, myStale(false)
+	, myEmpty(true)
+	, myKey(KeyType(0))
+{
+}
+template<class KeyType, std::size_t CacheLineSize, bool Enabled>
+inline void top_key_cache<KeyType, CacheLineSize, Enabled>::mark_stale()
+{
+	myStale.store(true);
+}
+template<class KeyType, std::size_t CacheLineSize, bool Enabled>
+inline const bool top_key_cache<KeyType, CacheLineSize, Enabled>::is_stale() const
+{
+	return myStale.load();
+}
+template<class KeyType, std::size_t CacheLineSize, bool Enabled>
+inline const bool top_key_cache<KeyType, CacheLineSize, Enabled>::try_begin_publish()
+{
+	uint32_t sequence(mySequence.load(std::memory_order_relaxed));
+
+	if ((sequence & 1) || !mySequence.compare_exchange_strong(sequence, sequence + 1)) {
+		return false;
+	}
+
+	myStale.store(false);
+
+	return true;
+}
+template<class KeyType, std::size_t CacheLineSize, bool Enabled>
+inline void top_key_cache<KeyType, CacheLineSize, Enabled>::end_publish(const KeyType key, const bool empty)
+{
+	unsafe_publish(key, empty);
+
+	mySequence.fetch_add(1);
+}
+template<class KeyType, std::size_t CacheLineSize, bool Enabled>
+inline void top_key_cache<KeyType, CacheLineSize, Enabled>::unsafe_publish(const KeyType key, const bool empty)
+{
+	myKey.store(key, std::memory_order_relaxed);
+	myEmpty.store(empty, std::memory_order_relaxed);
+}
+template<class KeyType, std::size_t CacheLineSize, bool Enabled>
+inline const bool top_key_cache<KeyType, CacheLineSize, Enabled>::read(KeyType & out) const
+{
+	for (;;) {
+		const uint32_t sequence(mySequence.load(std::memory_order_acquire));
+
+		if (sequence & 1) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		const KeyType key(myKey.load(std::memory_order_relaxed));
+		const bool empty(myEmpty.load(std::memory_order_relaxed));
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		if (mySequence.load(std::memory_order_relaxed) == sequence) {
+			if (empty) {
+				return false;
+			}
+			out = key;
+			return true;
+		}
+	}
+}
+inline front_signal::front_signal()
+	: myRaisedList(nullptr)
+	, myRaising(0)
+	, myRaised(false)
+	, myNext(nullptr)
+	, myIndex(0)
+{
+}
+inline void front_signal::raise()
+{
+	if (!myRaisedList.load()) {
+		return;
+	}
+
+	// Pairs with unwatch storing myRaisedList, then loading myRaising
+	myRaising.fetch_add(1);
+
+	std::atomic<front_signal*>* const raised(myRaisedList.load());
+
+	if (raised && !myRaised.exchange(true)) {
+		front_signal* expected(raised->load(std::memory_order_relaxed));
+		do {
+			myNext.store(expected, std::memory_order_relaxed);
+		} while (!raised->compare_exchange_weak(expected, this, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	myRaising.fetch_sub(1, std::memory_order_release);
+}
+inline void front_signal::watch(std::atomic<front_signal*>& raised, std::size_t index)
+{
+	myIndex = index;
+	myRaised.store(false, std::memory_order_relaxed);
+	myRaisedList.store(&raised);
+}
+inline void front_signal::unwatch()
+{
+	myRaisedList.store(nullptr);
+
+	// Sequentially consistent with the store above, or the load could be 
+	// ordered before it and miss a raise that saw the old list
+	while (myRaising.load(std::memory_order_seq_cst)) {
+		std::this_thread::yield();
+	}
+}
+inline void front_signal::lower()
+{
+	myRaised.store(false);
+}
+inline const std::size_t front_signal::index() const
+{
+	return myIndex;
+}
+inline front_signal* const front_signal::next() const
+{
+	return myNext.load(std::memory_order_relaxed);
+}
+template <class KeyType, class NodeType, class SharedPtrType>
+struct jump_sample
+{
+	KeyType myKey;
+	NodeType* myNode;
+
+	// Keeps myNode alive for as long as the index exists
+	SharedPtrType myOwner;
+};
+// Sorted samples, splitting the list into segments. Segment i holds the 
+// entries after sample i - 1 up to and including sample i, and the last 
+// segment those after the last sample
+template <class SampleType>
+class jump_samples : public std::vector<SampleType>
+{
+public:
+	jump_samples();
+
+	// Counts length entries in every segment but the last, which gets lastLength
+	void reset_weights(std::size_t length, std::size_t lastLength);
+
+	// Counts may be moved by users of a shared, constant set of samples
+	void add_weight(std::size_t segment, std::ptrdiff_t delta) const;
+
+	// Entries counted in segment and the ones after it
+	const std::ptrdiff_t weight_from(std::size_t segment) const;
+
+	// The segment holding the entry with behind - 1 entries after it
+	const std::size_t find_from_back(std::ptrdiff_t behind) const;
+
+private:
+	// A Fenwick tree over the segments in reverse order, so that its prefix
+	// sums count from the back of the list
+	std::unique_ptr<std::atomic<std::ptrdiff_t>[]> myWeights;
+	std::size_t mySegments;
+};
+template <class SampleType>
+inline jump_samples<SampleType>::jump_samples()
+	: mySegments(0)
+{
+}
+template <class SampleType>
+inline void jump_samples<SampleType>::reset_weights(std::size_t length, std::size_t lastLength)
+{
+	mySegments = this->size() + 1;
+	myWeights.reset(new std::atomic<std::ptrdiff_t>[mySegments + 1]);
 
-		if (next.get_tag()) {
-			next.clear_tag();
+	myWeights[0].store(0, std::memory_order_relaxed);
+	for (std::size_t i = 1; i <= mySegments; ++i) {
+		myWeights[i].store(static_cast<std::ptrdiff_t>(i == 1 ? lastLength : length), std::memory_order_relaxed);
+	}
+	for (std::size_t i = 1; i <= mySegments; ++i) {
+		const std::size_t parent(i + (i & (0 - i)));
+		if (parent <= mySegments) {
+			myWeights[parent].store(myWeights[parent].load(std::memory_order_relaxed) + myWeights[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		}
+	}
+}
+template <class SampleType>
+inline void jump_samples<SampleType>::add_weight(std::size_t segment, std::ptrdiff_t delta) const
+{
+	if (!(segment < mySegments)) {
+		return;
+	}
+	for (std::size_t i = mySegments - segment; i <= mySegments; i += i & (0 - i)) {
+		myWeights[i].fetch_add(delta, std::memory_order_relaxed);
+	}
+}
+template <class SampleType>
+inline const std::ptrdiff_t jump_samples<SampleType>::weight_from(std::size_t segment) const
+{
+	if (!(segment < mySegments)) {
+		return 0;
+	}
 
-			versioned_raw_ptr_type expected(current.get_versioned_raw_ptr());
-			if (insertionPoint->myNext.compare_exchange_strong(expected, std::move(next))) {
-				shared_ptr_type null(nullptr);
-				null.set_tag();
-				current->myNext.store(null);
-			}
+	std::ptrdiff_t sum(0);
+	for (std::size_t i = mySegments - segment; i; i -= i & (0 - i)) {
+		sum += myWeights[i].load(std::memory_order_relaxed);
+	}
+	return sum;
+}
+template <class SampleType>
+inline const std::size_t jump_samples<SampleType>::find_from_back(std::ptrdiff_t behind) const
+{
+	if (!mySegments) {
+		return 0;
+	}
 
-			current = insertionPoint->myNext.load();
+	std::size_t step(1);
+	while (step <= mySegments / 2) {
+		step *= 2;
+	}
 
-			if (current.get_tag()) {
-				return false;
-			}
+	// Finds the longest run of segments, from the back, counting fewer than behind
+	std::size_t position(0);
+	for (; step; step /= 2) {
+		if (mySegments < position + step) {
+			continue;
 		}
-		else {
-			last = std::move(current);
-			current = std::move(next);
-			insertionPoint = static_cast<csldetail::node<key_type, value_type>*>(last);
+		const std::ptrdiff_t weight(myWeights[position + step].load(std::memory_order_relaxed));
+		if (weight < behind) {
+			position += step;
+			behind -= weight;
 		}
-	};
+	}
 
-	versioned_raw_ptr_type expected(current.get_versioned_raw_ptr());
-	entry->myNext.unsafe_store(std::move(current));
+	// Counts that fall short place the entry in the first segment
+	return position < mySegments ? mySegments - 1 - position : 0;
+}
+template <class KeyType, class NodeType, class SharedPtrType, std::size_t CacheLineSize, bool Enabled>
+class jump_index
+{
+public:
+	typedef jump_sample<KeyType, NodeType, SharedPtrType> sample_type;
+	typedef jump_samples<sample_type> samples_type;
+	typedef shared_ptr<samples_type> samples_ptr_type;
 
-	if (insertionPoint->myNext.compare_exchange_strong(expected, std::move(entry))) {
-		return true;
+	jump_index();
+
+	// Samples are replaced whole, readers keeping the old ones alive until done
+	samples_ptr_type load();
+	void store(samples_ptr_type&& samples);
+
+	const bool has_samples() const;
+
+	// The rebuild functions below are only called between these two
+	const bool try_begin_rebuild();
+	void end_rebuild();
+
+	// Whether a rebuild has been started but not yet finished
+	const bool rebuilding() const;
+
+	// Samples up to maxNodes further nodes, starting a new rebuild from
+	// front if none is under way. Stores the new samples once the walk 
+	// reaches the end of the list, returning true
+	template <class FrontLink>
+	const bool rebuild_step(FrontLink& front, std::size_t stride, std::size_t expectedSize, std::size_t maxNodes);
+	void abandon_rebuild();
+
+	void unsafe_reset();
+
+private:
+	CSL_PADD(CacheLineSize);
+	atomic_shared_ptr<samples_type> mySamples;
+	std::atomic<bool> myRebuilding;
+	std::atomic<bool> myInProgress;
+
+	// Touched only by the holder of myRebuilding
+	samples_ptr_type myPending;
+	SharedPtrType myCursor;
+	std::size_t myPosition;
+	CSL_PADD(CacheLineSize - ((sizeof(atomic_shared_ptr<samples_type>) + sizeof(std::atomic<bool>) * 2 + sizeof(samples_ptr_type) + sizeof(SharedPtrType) + sizeof(std::size_t)) % CacheLineSize));
+};
+template <class KeyType, class NodeType, class SharedPtrType, std::size_t CacheLineSize>
+class jump_index<KeyType, NodeType, SharedPtrType, CacheLineSize, false>
+{
+public:
+	typedef jump_sample<KeyType, NodeType, SharedPtrType> sample_type;
+	typedef jump_samples<sample_type> samples_type;
+	typedef shared_ptr<samples_type> samples_ptr_type;
+
+	samples_ptr_type load() { return samples_ptr_type(nullptr); }
+	void store(samples_ptr_type&&) {}
+	const bool has_samples() const { return false; }
+	const bool try_begin_rebuild() { return false; }
+	void end_rebuild() {}
+	void abandon_rebuild() {}
+	void unsafe_reset() {}
+};
+template <class KeyType, class NodeType, class SharedPtrType, std::size_t CacheLineSize, bool Enabled>
+inline jump_index<KeyType, NodeType, SharedPtrType, CacheLineSize, Enabled>::jump_index()
+	: mySamples(nullptr)
+	, myRebuilding(false)
+	, myInProgress(false)
+	, myPending(nullptr)
+	, myCursor(nullptr)
+	, myPosition(0)
+{
+}
+template <class KeyType, class NodeType, class SharedPtrType, std::size_t CacheLineSize, bool Enabled>
+inline typename jump_index<KeyType, NodeType, SharedPtrType, CacheLineSize, Enabled>::samples_ptr_type jump_index<KeyType, NodeType, SharedPtrType, CacheLineSize, Enabled>::load()
+{
+	return mySamples.load();
+}
+template <class KeyType, class NodeType, class SharedPtrType, std::size_t CacheLineSize, bool Enabled>
+inline void jump_index<KeyType, NodeType, SharedPtrType, CacheLineSize, Enabled>::store(samples_ptr_type && samples)
+{
+	mySamples.store(std::move(samples));
+}
+template <class KeyType, class NodeType, class SharedPtrType, std::size_t CacheLineSize, bool Enabled>
+inline const bool jump_index<KeyType, NodeType, SharedPtrType, CacheLineSize, Enabled>::has_samples() const
+{
+	return static_cast<bool>(mySamples);
+}
+template <class KeyType, class NodeType, class SharedPtrType, std::size_t CacheLineSize, bool Enabled>
+inline const bool jump_index<KeyType, NodeType, SharedPtrType, CacheLineSize, Enabled>::try_begin_rebuild()
+{
+	return !myRebuilding.load(std::memory_order_relaxed) && !myRebuilding.exchange(true, std::memory_order_acquire);
+}
+template <class KeyType, class NodeType, class SharedPtrType, std::size_t CacheLineSize, bool Enabled>
+inline void jump_index<KeyType, NodeType, SharedPtrType, CacheLineSize, Enabled>::end_rebuild()
+{
+	myRebuilding.store(false, std::memory_order_release);
+}
+template <class KeyType, class NodeType, class SharedPtrType, std::size_t CacheLineSize, bool Enabled>
+inline const bool jump_index<KeyType, NodeType, SharedPtrType, CacheLineSize, Enabled>::rebuilding() const
+{
+	return myInProgress.load(std::memory_order_relaxed);
+}
+template <class KeyType, class NodeType, class SharedPtrType, std::size_t CacheLineSize, bool Enabled>
+template <class FrontLink>
+inline const bool jump_index<KeyType, NodeType, SharedPtrType, CacheLineSize, Enabled>::rebuild_step(FrontLink& front, std::size_t stride, std::size_t expectedSize, std::size_t maxNodes)
+{
+	if (!myPending) {
+		myPending = make_shared<samples_type>();
+		myPending->reserve(expectedSize / stride + 1);
+		myCursor = front.load();
+		myPosition = 0;
+		myInProgress.store(true, std::memory_order_relaxed);
 	}
 
-	return false;
+	// Deleted nodes are passed over. Should one turn out to be unlinked
+	// already the walk ends early, leaving the rest of the list unsampled
+	for (std::size_t visited(0); myCursor && visited < maxNodes; ++visited, myCursor = myCursor->myNext.load()) {
+		if (myCursor->myNext.get_tag()) {
+			continue;
+		}
+		if (++myPosition % stride) {
+			continue;
+		}
+
+		myPending->push_back({ myCursor->myKeyValuePair.first, static_cast<NodeType*>(myCursor), myCursor });
+	}
+
+	if (myCursor) {
+		return false;
+	}
+
+	myPending->reset_weights(stride, myPosition % stride);
+
+	mySamples.store(std::move(myPending));
+	abandon_rebuild();
+
+	return true;
 }
+template <class KeyType, class NodeType, class SharedPtrType, std::size_t CacheLineSize, bool Enabled>
+inline void jump_index<KeyType, NodeType, SharedPtrType, CacheLineSize, Enabled>::abandon_rebuild()
+{
+	myPending = samples_ptr_type(nullptr);
+	myCursor = SharedPtrType(nullptr);
+	myInProgress.store(false, std::memory_order_relaxed);
+}
+template <class KeyType, class NodeType, class SharedPtrType, std::size_t CacheLineSize, bool Enabled>
+inline void jump_index<KeyType, NodeType, SharedPtrType, CacheLineSize, Enabled>::unsafe_reset()
+{
+	abandon_rebuild();
+	mySamples.unsafe_store(nullptr);
+}
+template <class KeyType, class Comparator, std::size_t Buckets, std::size_t Shards, std::size_t CacheLineSize, bool Enabled>
+class quantile_sketch
+{
+public:
+	quantile_sketch();
+
+	// Counts key into the calling thread's shard. Returns true once enough
+	// has changed since the bounds were drawn that they should be redrawn
+	const bool add(const KeyType& key, std::ptrdiff_t delta, const Comparator& comparator);
+
+	const bool quantile(double q, KeyType& out);
+
+	// rebuild is only called between these two
+	const bool try_begin_rebuild();
+	void end_rebuild();
+
+	// Draws bounds at even ranks of keys, which are in list order, and 
+	// counts them in. Replaces the histogram whole
+	void rebuild(const std::vector<KeyType>& keys, const Comparator& comparator);
+
+	void unsafe_reset();
+
+private:
+	// Shards are summed for every change check, so each is only checked 
+	// this often by its own writers
+	static constexpr std::size_t Check_Interval = 32;
+
+	struct shard
+	{
+		std::atomic<std::ptrdiff_t> myCounts[Buckets];
+		std::atomic<std::size_t> myChanges;
+		CSL_PADD(CacheLineSize - ((sizeof(std::atomic<std::ptrdiff_t>) * Buckets + sizeof(std::atomic<std::size_t>)) % CacheLineSize));
+	};
 
-template<class KeyType, class ValueType, class Comparator>
-inline const bool concurrent_sorted_list<KeyType, ValueType, Comparator>::try_pop_internal(key_type & expectedKey, value_type & outValue, const bool matchKey)
+	// Bucket i holds the keys from bound i - 1 up to bound i, the first and
+	// last buckets those beyond the outermost bounds
+	struct histogram
+	{
+		histogram();
+
+		KeyType myBounds[Buckets - 1];
+		std::size_t myBoundCount;
+
+		// Changes summed over the shards that call for a redraw
+		std::size_t myRedrawAt;
+
+		CSL_PADD(CacheLineSize - ((sizeof(KeyType) * (Buckets - 1) + sizeof(std::size_t) * 2) % CacheLineSize));
+		shard myShards[Shards];
+	};
+
+	CSL_PADD(CacheLineSize);
+	atomic_shared_ptr<histogram> myHistogram;
+	std::atomic<bool> myRebuilding;
+	CSL_PADD(CacheLineSize - ((sizeof(atomic_shared_ptr<histogram>) + sizeof(std::atomic<bool>)) % CacheLineSize));
+};
+template <class KeyType, class Comparator, std::size_t Buckets, std::size_t Shards, std::size_t CacheLineSize>
+class quantile_sketch<KeyType, Comparator, Buckets, Shards, CacheLineSize, false>
+{
+public:
+	const bool add(const KeyType&, std::ptrdiff_t, const Comparator&) { return false; }
+	const bool quantile(double, KeyType&) { return false; }
+	const bool try_begin_rebuild() { return false; }
+	void end_rebuild() {}
+	void rebuild(const std::vector<KeyType>&, const Comparator&) {}
+	void unsafe_reset() {}
+};
+template <class KeyType, class Comparator, std::size_t Buckets, std::size_t Shards, std::size_t CacheLineSize, bool Enabled>
+inline quantile_sketch<KeyType, Comparator, Buckets, Shards, CacheLineSize, Enabled>::quantile_sketch()
+	: myHistogram(nullptr)
+	, myRebuilding(false)
+{
+}
+template <class KeyType, class Comparator, std::size_t Buckets, std::size_t Shards, std::size_t CacheLineSize, bool Enabled>
+inline quantile_sketch<KeyType, Comparator, Buckets, Shards, CacheLineSize, Enabled>::histogram::histogram()
+	: myBoundCount(0)
+	, myRedrawAt(0)
+{
+	for (shard& s : myShards) {
+		for (std::atomic<std::ptrdiff_t>& count : s.myCounts) {
+			count.store(0, std::memory_order_relaxed);
+		}
+		s.myChanges.store(0, std::memory_order_relaxed);
+	}
+}
+template <class KeyType, class Comparator, std::size_t Buckets, std::size_t Shards, std::size_t CacheLineSize, bool Enabled>
+inline const bool quantile_sketch<KeyType, Comparator, Buckets, Shards, CacheLineSize, Enabled>::add(const KeyType & key, std::ptrdiff_t delta, const Comparator & comparator)
 {
-	const size_type currentSize(mySize.fetch_sub(1, std::memory_order_acq_rel) - 1);
-	const size_type difference(std::numeric_limits<size_type>::max() - (currentSize));
-	const size_type threshhold(std::numeric_limits<size_type>::max() / 2);
+	shared_ptr<histogram> h(myHistogram.load());
 
-	if (difference < threshhold) {
-		mySize.fetch_add(1, std::memory_order_relaxed);
+	if (!h) {
+		return true;
+	}
+
+	const std::size_t bucket(static_cast<std::size_t>(std::upper_bound(h->myBounds, h->myBounds + h->myBoundCount, key, comparator) - h->myBounds));
+
+	shard& own(h->myShards[thread_slot() % Shards]);
+	own.myCounts[bucket].fetch_add(delta, std::memory_order_relaxed);
+
+	if ((own.myChanges.fetch_add(1, std::memory_order_relaxed) + 1) % Check_Interval) {
 		return false;
 	}
 
-	shared_ptr_type head(nullptr);
-	shared_ptr_type splice(nullptr);
+	std::size_t changes(0);
+	for (const shard& s : h->myShards) {
+		changes += s.myChanges.load(std::memory_order_relaxed);
+	}
 
-	versioned_raw_ptr_type expected(nullptr);
+	return !(changes < h->myRedrawAt);
+}
+template <class KeyType, class Comparator, std::size_t Buckets, std::size_t Shards, std::size_t CacheLineSize, bool Enabled>
+inline const bool quantile_sketch<KeyType, Comparator, Buckets, Shards, CacheLineSize, Enabled>::quantile(double q, KeyType & out)
+{
+	shared_ptr<histogram> h(myHistogram.load());
 
-	for (;;) {
-		head = myFrontSentry->myNext.load();
+	if (!h || !h->myBoundCount) {
+		return false;
+	}
 
-		const key_type key(head->myKeyValuePair.first);
-		if (matchKey & (expectedKey != key)) {
-			expectedKey = key;
-			return false;
+	// Shards are read at different times, and buckets may sum below zero
+	std::ptrdiff_t counts[Buckets];
+	std::ptrdiff_t total(0);
+	for (std::size_t i = 0; i <= h->myBoundCount; ++i) {
+		std::ptrdiff_t sum(0);
+		for (const shard& s : h->myShards) {
+			sum += s.myCounts[i].load(std::memory_order_relaxed);
 		}
+		counts[i] = 0 < sum ? sum : 0;
+		total += counts[i];
+	}
 
-		splice = head->myNext.load_and_tag();
-		const bool mine(!splice.get_tag());
-		splice.clear_tag();
+	if (!total) {
+		return false;
+	}
 
-		expected = head.get_versioned_raw_ptr();
-		if (myFrontSentry->myNext.compare_exchange_strong(expected, std::move(splice))) {
-			shared_ptr_type null(nullptr);
-			null.set_tag();
-			head->myNext.store(null);
-		}
+	const double target((std::min)((std::max)(q, 0.0), 1.0) * static_cast<double>(total));
 
-		if (mine) {
+	double ahead(0.0);
+	std::size_t bucket(0);
+	for (; bucket < h->myBoundCount; ++bucket) {
+		if (counts[bucket] && !(ahead + static_cast<double>(counts[bucket]) < target)) {
 			break;
 		}
+		ahead += static_cast<double>(counts[bucket]);
 	}
-	expectedKey = head->myKeyValuePair.first;
-	outValue = head->myKeyValuePair.second;
+
+	// The outer buckets have no far bound to interpolate towards
+	if (!bucket || bucket == h->myBoundCount) {
+		out = h->myBounds[bucket ? bucket - 1 : 0];
+		return true;
+	}
+
+	const KeyType from(h->myBounds[bucket - 1]);
+	const KeyType to(h->myBounds[bucket]);
+	const double fraction((target - ahead) / static_cast<double>(counts[bucket]));
+
+	out = fraction < 1.0 ? static_cast<KeyType>(static_cast<double>(from) + fraction * (static_cast<double>(to) - static_cast<double>(from))) : to;
 
 	return true;
 }
-namespace csldetail
+template <class KeyType, class Comparator, std::size_t Buckets, std::size_t Shards, std::size_t CacheLineSize, bool Enabled>
+inline const bool quantile_sketch<KeyType, Comparator, Buckets, Shards, CacheLineSize, Enabled>::try_begin_rebuild()
 {
-template <class KeyType, class ValueType>
-class node
+	return !myRebuilding.load(std::memory_order_relaxed) && !myRebuilding.exchange(true, std::memory_order_acquire);
+}
+template <class KeyType, class Comparator, std::size_t Buckets, std::size_t Shards, std::size_t CacheLineSize, bool Enabled>
+inline void quantile_sketch<KeyType, Comparator, Buckets, Shards, CacheLineSize, Enabled>::end_rebuild()
 {
-public:
-	constexpr node();
+	myRebuilding.store(false, std::memory_order_release);
+}
+template <class KeyType, class Comparator, std::size_t Buckets, std::size_t Shards, std::size_t CacheLineSize, bool Enabled>
+inline void quantile_sketch<KeyType, Comparator, Buckets, Shards, CacheLineSize, Enabled>::rebuild(const std::vector<KeyType>& keys, const Comparator & comparator)
+{
+	shared_ptr<histogram> h(make_shared<histogram>());
 
-	typedef KeyType key_type;
-	typedef ValueType value_type;
-	typedef typename concurrent_sorted_list<key_type, value_type>::atomic_shared_ptr_type atomic_shared_ptr_type;
+	const std::size_t entries(keys.size());
+	const std::size_t bounds((std::min)(Buckets - 1, entries));
 
-	std::pair<key_type, value_type> myKeyValuePair;
-	atomic_shared_ptr_type myNext;
-};
-template<class KeyType, class ValueType>
-inline constexpr node<KeyType, ValueType>::node()
-	: myKeyValuePair{ std::numeric_limits<key_type>::min(), value_type() }
-	, myNext(nullptr)
+	// The first and last keys are always bounds. Repeated keys make for 
+	// fewer bounds
+	for (std::size_t i = 0; i < bounds; ++i) {
+		const KeyType& bound(keys[bounds == 1 ? 0 : i * (entries - 1) / (bounds - 1)]);
+
+		if (h->myBoundCount && !comparator(h->myBounds[h->myBoundCount - 1], bound)) {
+			continue;
+		}
+		h->myBounds[h->myBoundCount++] = bound;
+	}
+
+	std::size_t bucket(0);
+	for (const KeyType& key : keys) {
+		while (bucket < h->myBoundCount && !comparator(key, h->myBounds[bucket])) {
+			++bucket;
+		}
+		h->myShards[0].myCounts[bucket].store(h->myShards[0].myCounts[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	h->myRedrawAt = (std::max)(entries, Buckets);
+
+	myHistogram.store(std::move(h));
+}
+template <class KeyType, class Comparator, std::size_t Buckets, std::size_t Shards, std::size_t CacheLineSize, bool Enabled>
+inline void quantile_sketch<KeyType, Comparator, Buckets, Shards, CacheLineSize, Enabled>::unsafe_reset()
 {
+	myHistogram.unsafe_store(nullptr);
 }
+// Progress of a redraw of the quantile sketch, spread over list operations
+template <class KeyType, class SharedPtrType, bool Enabled>
+struct quantile_walk
+{
+	quantile_walk() : myCursor(nullptr), myActive(false) {}
+
+	const bool active() const { return myActive.load(std::memory_order_relaxed); }
+
+	void reset() {
+		myCursor = SharedPtrType(nullptr);
+		myKeys.clear();
+		myActive.store(false, std::memory_order_relaxed);
+	}
+
+	// The next node to visit
+	SharedPtrType myCursor;
+	std::vector<KeyType> myKeys;
+
+	// Read by every operation counting in
+	std::atomic<bool> myActive;
+};
+template <class KeyType, class SharedPtrType>
+struct quantile_walk<KeyType, SharedPtrType, false>
+{
+	const bool active() const { return false; }
+	void reset() {}
+};
 struct tiny_less
 {
 	template <class T>
@@ -338,5 +3166,212 @@ struct tiny_less
 		return a < b;
 	};
 };
+template <class KeyType, class ValueType, class Deadline>
+struct alloc_size_rep : Deadline
+{
+	std::pair<KeyType, ValueType> dummy1;
+	atomic_shared_ptr<int> dummy2;
+};
+template <class KeyType, class ValueType, class Deadline>
+class alloc_type
+{
+	uint8_t myBlock[shared_ptr<alloc_size_rep<KeyType, ValueType, Deadline>>::Alloc_Size_Make_Shared];
+};
+template <class AllocType>
+class pool_allocator
+{
+public:
+	typedef uint8_t value_type;
+
+	pool_allocator(concurrent_object_pool<AllocType>* memPool) : myMemoryPool(memPool) {}
+	pool_allocator(const pool_allocator<AllocType>& other) : myMemoryPool(other.myMemoryPool) {}
+	pool_allocator& operator=(const pool_allocator<AllocType>& other) { myMemoryPool = other.myMemoryPool; return *this; }
+
+	uint8_t* allocate(std::size_t n) {
+		assert(n <= sizeof(AllocType) && "Node does not fit in pool block");
+		(void)n;
+		return reinterpret_cast<uint8_t*>(myMemoryPool->get_object());
+	}
+	void deallocate(uint8_t* ptr, std::size_t /*n*/) {
+		myMemoryPool->recycle_object(reinterpret_cast<AllocType*>(ptr));
+	}
+
+	const bool operator==(const pool_allocator<AllocType>& other) const {
+		return myMemoryPool == other.myMemoryPool;
+	}
+	const bool operator!=(const pool_allocator<AllocType>& other) const {
+		return !operator==(other);
+	}
+
+private:
+	concurrent_object_pool<AllocType>* myMemoryPool;
+};
+template <class Allocator, class AllocType>
+struct select_allocator
+{
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<uint8_t> type;
+};
+template <class AllocType>
+struct select_allocator<csl_node_pool_allocator, AllocType>
+{
+	typedef pool_allocator<AllocType> type;
+};
+inline void prefetch(const void* address)
+{
+	_mm_prefetch(reinterpret_cast<const char*>(address), _MM_HINT_T0);
+}
+inline const std::size_t thread_slot()
+{
+	static std::atomic<std::size_t> ourSlotIterator(0);
+	thread_local const std::size_t slot(ourSlotIterator.fetch_add(1, std::memory_order_relaxed));
+
+	return slot;
+}
+template <class AllocType>
+inline concurrent_object_pool<AllocType>& global_node_pool(std::size_t blockSize)
+{
+	static concurrent_object_pool<AllocType> pool(blockSize);
+	return pool;
+}
+}
+template<uint32_t Max_Spin>
+inline void csl_exponential_backoff<Max_Spin>::operator()()
+{
+	if (Max_Spin < mySpin) {
+		std::this_thread::yield();
+		return;
+	}
+	for (uint32_t i = 0; i < mySpin; ++i) {
+		_mm_pause();
+	}
+	mySpin <<= 1;
+}
+inline csl_atomic_size::csl_atomic_size()
+	: myCount(0)
+{
+}
+inline void csl_atomic_size::add(std::ptrdiff_t delta)
+{
+	myCount.fetch_add(static_cast<std::size_t>(delta), std::memory_order_relaxed);
+}
+inline const bool csl_atomic_size::try_reserve()
+{
+	const std::size_t currentSize(myCount.fetch_sub(1, std::memory_order_acq_rel) - 1);
+	const std::size_t difference(std::numeric_limits<std::size_t>::max() - (currentSize));
+	const std::size_t threshhold(std::numeric_limits<std::size_t>::max() / 2);
+
+	if (difference < threshhold) {
+		myCount.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	return true;
+}
+inline const std::size_t csl_atomic_size::load() const
+{
+	return myCount.load(std::memory_order_acquire);
+}
+inline void csl_atomic_size::unsafe_add(std::ptrdiff_t delta)
+{
+	myCount.store(myCount.load(std::memory_order_relaxed) + static_cast<std::size_t>(delta), std::memory_order_relaxed);
+}
+inline void csl_atomic_size::unsafe_reset()
+{
+	myCount.store(0, std::memory_order_relaxed);
+}
+template <std::size_t Shards, std::size_t CacheLineSize>
+inline csl_sharded_size<Shards, CacheLineSize>::csl_sharded_size()
+{
+	unsafe_reset();
+}
+template <std::size_t Shards, std::size_t CacheLineSize>
+inline void csl_sharded_size<Shards, CacheLineSize>::add(std::ptrdiff_t delta)
+{
+	myShards[csldetail::thread_slot() % Shards].myCount.fetch_add(delta, std::memory_order_relaxed);
+}
+template <std::size_t Shards, std::size_t CacheLineSize>
+inline const std::size_t csl_sharded_size<Shards, CacheLineSize>::load() const
+{
+	std::ptrdiff_t sum(0);
+	for (std::size_t i = 0; i < Shards; ++i) {
+		sum += myShards[i].myCount.load(std::memory_order_relaxed);
+	}
+
+	// Shards are read at different times and may sum below zero
+	return 0 < sum ? static_cast<std::size_t>(sum) : 0;
+}
+template <std::size_t Shards, std::size_t CacheLineSize>
+inline void csl_sharded_size<Shards, CacheLineSize>::unsafe_add(std::ptrdiff_t delta)
+{
+	std::atomic<std::ptrdiff_t>& count(myShards[csldetail::thread_slot() % Shards].myCount);
+	count.store(count.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+template <std::size_t Shards, std::size_t CacheLineSize>
+inline void csl_sharded_size<Shards, CacheLineSize>::unsafe_reset()
+{
+	for (std::size_t i = 0; i < Shards; ++i) {
+		myShards[i].myCount.store(0, std::memory_order_relaxed);
+	}
+}
+template <std::size_t CacheLineSize>
+inline csl_atomic_stats<CacheLineSize>::csl_atomic_stats()
+	: myInserts(0)
+	, myInsertRetries(0)
+	, myTraversedNodes(0)
+	, myPops(0)
+	, myPopRetries(0)
+	, myFailedPops(0)
+{
+}
+template <std::size_t CacheLineSize>
+inline void csl_atomic_stats<CacheLineSize>::on_insert(std::size_t traversed, std::size_t retries)
+{
+	myInserts.fetch_add(1, std::memory_order_relaxed);
+	myTraversedNodes.fetch_add(traversed, std::memory_order_relaxed);
+	if (retries) {
+		myInsertRetries.fetch_add(retries, std::memory_order_relaxed);
+	}
+}
+template <std::size_t CacheLineSize>
+inline void csl_atomic_stats<CacheLineSize>::on_pop(std::size_t retries)
+{
+	myPops.fetch_add(1, std::memory_order_relaxed);
+	if (retries) {
+		myPopRetries.fetch_add(retries, std::memory_order_relaxed);
+	}
+}
+template <std::size_t CacheLineSize>
+inline void csl_atomic_stats<CacheLineSize>::on_failed_pop()
+{
+	myFailedPops.fetch_add(1, std::memory_order_relaxed);
+}
+template <std::size_t CacheLineSize>
+inline const std::size_t csl_atomic_stats<CacheLineSize>::inserts() const
+{
+	return myInserts.load(std::memory_order_relaxed);
+}
+template <std::size_t CacheLineSize>
+inline const std::size_t csl_atomic_stats<CacheLineSize>::insert_retries() const
+{
+	return myInsertRetries.load(std::memory_order_relaxed);
+}
+template <std::size_t CacheLineSize>
+inline const std::size_t csl_atomic_stats<CacheLineSize>::traversed_nodes() const
+{
+	return myTraversedNodes.load(std::memory_order_relaxed);
+}
+template <std::size_t CacheLineSize>
+inline const std::size_t csl_atomic_stats<CacheLineSize>::pops() const
+{
+	return myPops.load(std::memory_order_relaxed);
+}
+template <std::size_t CacheLineSize>
+inline const std::size_t csl_atomic_stats<CacheLineSize>::pop_retries() const
+{
+	return myPopRetries.load(std::memory_order_relaxed);
+}
+template <std::size_t CacheLineSize>
+inline const std::size_t csl_atomic_stats<CacheLineSize>::failed_pops() const
+{
+	return myFailedPops.load(std::memory_order_relaxed);
 }
 }
\ No newline at end of file
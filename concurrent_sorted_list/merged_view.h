@@ -0,0 +1,240 @@
+// Copyright(c) 2019 Flovin Michaelsen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include "concurrent_sorted_list.h"
+#include "tournament_tree.h"
+
+namespace gdul
+{
+// Pops the lowest keyed entry across any number of source lists. The top key
+// of each source is kept in the leaves of a tournament tree. Sources signal 
+// changes to their front, and pops reread only those sources, replaying their
+// paths, before popping the winner by compare_try_pop. A pop is logarithmic 
+// in the number of sources, plus the sources changed since the last call. The
+// view itself is used by a single consumer thread, while the sources may be 
+// inserted to, and popped, concurrently. A source must be removed before it 
+// is destroyed
+template <class List>
+class merged_view
+{
+public:
+	typedef List list_type;
+	typedef typename list_type::size_type size_type;
+	typedef typename list_type::key_type key_type;
+	typedef typename list_type::value_type value_type;
+	typedef typename list_type::comparator_type comparator_type;
+
+	merged_view();
+	~merged_view();
+
+	// Adds list as a source, returning a handle for remove_source. Logarithmic
+	// in the number of sources, save for when the tree grows
+	const std::size_t add_source(list_type& list);
+	void remove_source(std::size_t handle);
+
+	const size_type sources() const;
+
+	// Pops the entry with the lowest key across the sources, as of the top keys
+	// read at the start of the call. Should another consumer of the winning 
+	// source get there first, it is reread and its path replayed, up to 
+	// Pop_Retries times before giving up
+	const bool try_pop(value_type& out);
+	const bool try_pop(std::pair<key_type, value_type>& out);
+
+	// Lowest top key hint across the sources
+	const bool try_peek_top_key(key_type& out);
+
+private:
+	static constexpr std::size_t Pop_Retries = 8;
+
+	// Rereads the top key of the sources that raised their signal
+	void refresh();
+
+	// Rereads the top key of one source, replaying it if changed
+	void reread(std::size_t index);
+
+	// Indexed like the leaves of the tree
+	std::vector<list_type*> mySources;
+	std::vector<std::size_t> myFreeLeaves;
+
+	// Pushed to by the sources on changes to their front
+	std::atomic<csldetail::front_signal*> myRaised;
+
+	csldetail::tournament_tree<key_type, comparator_type> myTree;
+
+	size_type mySourceCount;
+
+	comparator_type myComparator;
+};
+
+template <class List>
+inline merged_view<List>::merged_view()
+	: mySources(1, nullptr)
+	, myFreeLeaves(1, 0)
+	, myRaised(nullptr)
+	, mySourceCount(0)
+{
+}
+template <class List>
+inline merged_view<List>::~merged_view()
+{
+	for (list_type* source : mySources) {
+		if (source) {
+			source->myFrontSignal.unwatch();
+		}
+	}
+}
+template <class List>
+inline const std::size_t merged_view<List>::add_source(list_type & list)
+{
+	if (myFreeLeaves.empty()) {
+		const std::size_t leaves(myTree.leaves());
+
+		myTree.grow();
+		mySources.resize(leaves * 2, nullptr);
+
+		for (std::size_t i = leaves * 2 - 1; leaves <= i; --i) {
+			myFreeLeaves.push_back(i);
+		}
+	}
+
+	const std::size_t index(myFreeLeaves.back());
+	myFreeLeaves.pop_back();
+
+	mySources[index] = &list;
+
+	// Changes made past this point raise the signal
+	list.myFrontSignal.watch(myRaised, index);
+	reread(index);
+
+	++mySourceCount;
+
+	return index;
+}
+template <class List>
+inline void merged_view<List>::remove_source(std::size_t handle)
+{
+	assert(mySources[handle] && "Not a source of this view");
+
+	mySources[handle]->myFrontSignal.unwatch();
+
+	// The signal may still be pending
+	refresh();
+
+	mySources[handle] = nullptr;
+
+	myTree.clear(handle);
+
+	myFreeLeaves.push_back(handle);
+
+	--mySourceCount;
+}
+template <class List>
+inline const typename merged_view<List>::size_type merged_view<List>::sources() const
+{
+	return mySourceCount;
+}
+template <class List>
+inline const bool merged_view<List>::try_pop(value_type & out)
+{
+	std::pair<key_type, value_type> pair;
+	if (!try_pop(pair)) {
+		return false;
+	}
+	out = std::move(pair.second);
+	return true;
+}
+template <class List>
+inline const bool merged_view<List>::try_pop(std::pair<key_type, value_type>& out)
+{
+	refresh();
+
+	for (std::size_t retry = 0; retry < Pop_Retries; ++retry) {
+		const std::size_t winner(myTree.winner());
+
+		if (!myTree.has_key(winner)) {
+			return false;
+		}
+
+		out.first = myTree.key(winner);
+		const bool popped(mySources[winner]->compare_try_pop(out));
+
+		reread(winner);
+
+		if (popped) {
+			return true;
+		}
+	}
+
+	return false;
+}
+template <class List>
+inline const bool merged_view<List>::try_peek_top_key(key_type & out)
+{
+	refresh();
+
+	const std::size_t winner(myTree.winner());
+
+	if (!myTree.has_key(winner)) {
+		return false;
+	}
+
+	out = myTree.key(winner);
+
+	return true;
+}
+template <class List>
+inline void merged_view<List>::refresh()
+{
+	if (!myRaised.load(std::memory_order_relaxed)) {
+		return;
+	}
+
+	for (csldetail::front_signal* signal(myRaised.exchange(nullptr, std::memory_order_acquire)); signal;) {
+		csldetail::front_signal* const next(signal->next());
+
+		// Changes from here on raise anew
+		signal->lower();
+		reread(signal->index());
+
+		signal = next;
+	}
+}
+template <class List>
+inline void merged_view<List>::reread(std::size_t index)
+{
+	key_type key(myTree.key(index));
+	const bool hasKey(mySources[index]->try_peek_top_key(key));
+
+	if (!hasKey) {
+		if (myTree.has_key(index)) {
+			myTree.clear(index);
+		}
+		return;
+	}
+
+	const key_type& cached(myTree.key(index));
+	if (!myTree.has_key(index) || myComparator(key, cached) || myComparator(cached, key)) {
+		myTree.set(index, key);
+	}
+}
+}
@@ -0,0 +1,312 @@
+// Copyright(c) 2019 Flovin Michaelsen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include "concurrent_sorted_list.h"
+#include "shard_gate.h"
+
+namespace gdul
+{
+// Spreads entries over Shards concurrent_sorted_lists, each holding a
+// contiguous key range. Inserts to different ranges touch different lists,
+// while pops take from the lowest non-empty shard. Split keys between shards
+// move as the shards grow unevenly, so that their sizes stay comparable. A 
+// move cuts the entries past the new split key off the larger shard and 
+// merges them into its neighbour, with the shards briefly closed
+template <class KeyType, class ValueType, class Comparator = csldetail::tiny_less, class Traits = csl_default_traits, std::size_t Shards = 8>
+class range_partitioned_sorted_list
+{
+public:
+	typedef concurrent_sorted_list<KeyType, ValueType, Comparator, Traits> list_type;
+	typedef typename list_type::size_type size_type;
+	typedef typename list_type::key_type key_type;
+	typedef typename list_type::value_type value_type;
+	typedef typename list_type::comparator_type comparator_type;
+
+	static_assert(1 < Shards, "range_partitioned_sorted_list needs at least two shards");
+
+	// Inserts take no deadline, and a bound per shard would not bound the whole
+	static_assert(!Traits::expiry_policy::Expires, "range_partitioned_sorted_list does not support expiry");
+	static_assert(!Traits::Capacity, "range_partitioned_sorted_list does not support Capacity");
+
+	// Shards start out covering even parts of the expected key range. Keys
+	// outside of it are accepted, and land in the first or last shard
+	range_partitioned_sorted_list(const key_type& low, const key_type& high);
+
+	// Sum of the shard sizes
+	const size_type size() const;
+
+	const bool insert(const std::pair<key_type, value_type>& in);
+	const bool insert(std::pair<key_type, value_type>&& in);
+
+	const bool try_pop(value_type& out);
+	const bool try_pop(std::pair<key_type, value_type>& out);
+
+	// Top key hint
+	const bool try_peek_top_key(key_type& out);
+
+	void unsafe_clear();
+
+	// The lowest key routed to the shard after index
+	const key_type split_key(std::size_t index) const;
+
+	const list_type& shard(std::size_t index) const;
+
+private:
+	// Shards are compared with their neighbours once they hold this many entries
+	static constexpr size_type Rebalance_Min_Size = 256;
+
+	// and then on every this many:th insert routed to them
+	static constexpr size_type Rebalance_Interval = 64;
+
+	static constexpr std::size_t Cache_Line_Size = Traits::Cache_Line_Size;
+
+	const std::size_t route(const key_type& key) const;
+
+	// Even parts of the range from low to high, computed in the unsigned type
+	// for integers so that ranges wider than half the key type do not overflow
+	static const key_type split_span(const key_type& low, const key_type& high, std::size_t parts, std::true_type);
+	static const key_type split_span(const key_type& low, const key_type& high, std::size_t parts, std::false_type);
+
+	// Evens out the sizes of shard index and its smaller neighbour, if far apart
+	void try_rebalance(std::size_t index);
+	void rebalance(std::size_t lower);
+
+	// Entered by inserts and pops, closed while moving a split key
+	csldetail::shard_gate<Shards * 2, Cache_Line_Size> myGate;
+
+	std::atomic<key_type> mySplits[Shards - 1];
+	CSL_PADD(Cache_Line_Size - (sizeof(std::atomic<key_type>) * (Shards - 1)) % Cache_Line_Size);
+
+	// Inserts routed to each shard, counting towards the next comparison. The
+	// shard sizes are approximate, and would skip past multiples of the interval
+	struct insert_count
+	{
+		std::atomic<size_type> myInserts;
+		CSL_PADD(Cache_Line_Size - (sizeof(std::atomic<size_type>) % Cache_Line_Size));
+	};
+	insert_count myInserts[Shards];
+
+	list_type myLists[Shards + 1];
+
+	// Into myLists. The spare takes the suffix cut off a shard when rebalancing
+	list_type* myShards[Shards];
+	list_type* mySpare;
+
+	comparator_type myComparator;
+};
+
+template <class KeyType, class ValueType, class Comparator, class Traits, std::size_t Shards>
+inline range_partitioned_sorted_list<KeyType, ValueType, Comparator, Traits, Shards>::range_partitioned_sorted_list(const key_type & low, const key_type & high)
+	: mySpare(&myLists[Shards])
+{
+	for (std::size_t i = 0; i < Shards; ++i) {
+		myShards[i] = &myLists[i];
+		myInserts[i].myInserts.store(0, std::memory_order_relaxed);
+	}
+	for (std::size_t i = 0; i < Shards - 1; ++i) {
+		mySplits[i].store(split_span(low, high, i + 1, std::is_integral<key_type>()), std::memory_order_relaxed);
+	}
+}
+template <class KeyType, class ValueType, class Comparator, class Traits, std::size_t Shards>
+inline const typename range_partitioned_sorted_list<KeyType, ValueType, Comparator, Traits, Shards>::size_type range_partitioned_sorted_list<KeyType, ValueType, Comparator, Traits, Shards>::size() const
+{
+	size_type sum(0);
+	for (const list_type* shard : myShards) {
+		sum += shard->size();
+	}
+	return sum;
+}
+template <class KeyType, class ValueType, class Comparator, class Traits, std::size_t Shards>
+inline const bool range_partitioned_sorted_list<KeyType, ValueType, Comparator, Traits, Shards>::insert(const std::pair<key_type, value_type>& in)
+{
+	return insert(std::pair<key_type, value_type>(in));
+}
+template <class KeyType, class ValueType, class Comparator, class Traits, std::size_t Shards>
+inline const bool range_partitioned_sorted_list<KeyType, ValueType, Comparator, Traits, Shards>::insert(std::pair<key_type, value_type>&& in)
+{
+	const std::size_t stripe(myGate.enter());
+
+	const std::size_t index(route(in.first));
+	const bool result(myShards[index]->insert(std::move(in)));
+
+	myGate.leave(stripe);
+
+	if (result) {
+		try_rebalance(index);
+	}
+
+	return result;
+}
+template <class KeyType, class ValueType, class Comparator, class Traits, std::size_t Shards>
+inline const bool range_partitioned_sorted_list<KeyType, ValueType, Comparator, Traits, Shards>::try_pop(value_type & out)
+{
+	std::pair<key_type, value_type> pair;
+	if (!try_pop(pair)) {
+		return false;
+	}
+	out = std::move(pair.second);
+	return true;
+}
+template <class KeyType, class ValueType, class Comparator, class Traits, std::size_t Shards>
+inline const bool range_partitioned_sorted_list<KeyType, ValueType, Comparator, Traits, Shards>::try_pop(std::pair<key_type, value_type>& out)
+{
+	const std::size_t stripe(myGate.enter());
+
+	bool result(false);
+	for (std::size_t i = 0; i < Shards && !result; ++i) {
+		result = myShards[i]->try_pop(out);
+	}
+
+	myGate.leave(stripe);
+
+	return result;
+}
+template <class KeyType, class ValueType, class Comparator, class Traits, std::size_t Shards>
+inline const bool range_partitioned_sorted_list<KeyType, ValueType, Comparator, Traits, Shards>::try_peek_top_key(key_type & out)
+{
+	const std::size_t stripe(myGate.enter());
+
+	bool result(false);
+	for (std::size_t i = 0; i < Shards && !result; ++i) {
+		result = myShards[i]->try_peek_top_key(out);
+	}
+
+	myGate.leave(stripe);
+
+	return result;
+}
+template <class KeyType, class ValueType, class Comparator, class Traits, std::size_t Shards>
+inline void range_partitioned_sorted_list<KeyType, ValueType, Comparator, Traits, Shards>::unsafe_clear()
+{
+	for (list_type& list : myLists) {
+		list.unsafe_clear();
+	}
+	for (insert_count& count : myInserts) {
+		count.myInserts.store(0, std::memory_order_relaxed);
+	}
+}
+template <class KeyType, class ValueType, class Comparator, class Traits, std::size_t Shards>
+inline const typename range_partitioned_sorted_list<KeyType, ValueType, Comparator, Traits, Shards>::key_type range_partitioned_sorted_list<KeyType, ValueType, Comparator, Traits, Shards>::split_key(std::size_t index) const
+{
+	return mySplits[index].load(std::memory_order_relaxed);
+}
+template <class KeyType, class ValueType, class Comparator, class Traits, std::size_t Shards>
+inline const typename range_partitioned_sorted_list<KeyType, ValueType, Comparator, Traits, Shards>::list_type & range_partitioned_sorted_list<KeyType, ValueType, Comparator, Traits, Shards>::shard(std::size_t index) const
+{
+	return *myShards[index];
+}
+template <class KeyType, class ValueType, class Comparator, class Traits, std::size_t Shards>
+inline const std::size_t range_partitioned_sorted_list<KeyType, ValueType, Comparator, Traits, Shards>::route(const key_type & key) const
+{
+	std::size_t low(0);
+	std::size_t high(Shards - 1);
+
+	while (low < high) {
+		const std::size_t mid((low + high) / 2);
+
+		if (myComparator(key, mySplits[mid].load(std::memory_order_relaxed))) {
+			high = mid;
+		}
+		else {
+			low = mid + 1;
+		}
+	}
+
+	return low;
+}
+template <class KeyType, class ValueType, class Comparator, class Traits, std::size_t Shards>
+inline const typename range_partitioned_sorted_list<KeyType, ValueType, Comparator, Traits, Shards>::key_type range_partitioned_sorted_list<KeyType, ValueType, Comparator, Traits, Shards>::split_span(const key_type & low, const key_type & high, std::size_t parts, std::true_type)
+{
+	typedef typename std::make_unsigned<key_type>::type unsigned_type;
+
+	const unsigned_type span(static_cast<unsigned_type>(static_cast<unsigned_type>(high) - static_cast<unsigned_type>(low)) / static_cast<unsigned_type>(Shards));
+
+	return static_cast<key_type>(static_cast<unsigned_type>(static_cast<unsigned_type>(low) + span * static_cast<unsigned_type>(parts)));
+}
+template <class KeyType, class ValueType, class Comparator, class Traits, std::size_t Shards>
+inline const typename range_partitioned_sorted_list<KeyType, ValueType, Comparator, Traits, Shards>::key_type range_partitioned_sorted_list<KeyType, ValueType, Comparator, Traits, Shards>::split_span(const key_type & low, const key_type & high, std::size_t parts, std::false_type)
+{
+	// Divided before subtracting, so that the difference does not overflow
+	const key_type span(high / static_cast<key_type>(Shards) - low / static_cast<key_type>(Shards));
+
+	return static_cast<key_type>(low + span * static_cast<key_type>(parts));
+}
+template <class KeyType, class ValueType, class Comparator, class Traits, std::size_t Shards>
+inline void range_partitioned_sorted_list<KeyType, ValueType, Comparator, Traits, Shards>::try_rebalance(std::size_t index)
+{
+	if ((myInserts[index].myInserts.fetch_add(1, std::memory_order_relaxed) + 1) % Rebalance_Interval) {
+		return;
+	}
+
+	const size_type size(myShards[index]->size());
+
+	if (size < Rebalance_Min_Size) {
+		return;
+	}
+
+	const size_type below(index ? myShards[index - 1]->size() : std::numeric_limits<size_type>::max());
+	const size_type above(index + 1 < Shards ? myShards[index + 1]->size() : std::numeric_limits<size_type>::max());
+
+	const std::size_t neighbour(below < above ? index - 1 : index + 1);
+	const size_type neighbourSize(below < above ? below : above);
+
+	if (size / 2 < neighbourSize) {
+		return;
+	}
+
+	rebalance(index < neighbour ? index : neighbour);
+}
+template <class KeyType, class ValueType, class Comparator, class Traits, std::size_t Shards>
+inline void range_partitioned_sorted_list<KeyType, ValueType, Comparator, Traits, Shards>::rebalance(std::size_t lower)
+{
+	if (!myGate.try_close()) {
+		return;
+	}
+
+	list_type& low(*myShards[lower]);
+	list_type& high(*myShards[lower + 1]);
+
+	const size_type lowSize(low.size());
+	const size_type highSize(high.size());
+	const size_type half((lowSize + highSize) / 2);
+
+	// Entries keyed the same as the new split all go above it
+	key_type split = key_type();
+	if (highSize < lowSize) {
+		if (low.select_approx(half, split) && low.split_at(split, *mySpare)) {
+			high.merge(std::move(*mySpare));
+			mySplits[lower].store(split, std::memory_order_relaxed);
+		}
+	}
+	else if (high.select_approx(highSize - half, split) && high.split_at(split, *mySpare)) {
+
+		// What remains of the upper shard is the prefix to move down. The
+		// cut off suffix takes its place, rather than being merged back
+		low.merge(std::move(high));
+		myShards[lower + 1] = mySpare;
+		mySpare = &high;
+		mySplits[lower].store(split, std::memory_order_relaxed);
+	}
+
+	myGate.open();
+}
+}
@@ -0,0 +1,114 @@
+// Copyright(c) 2019 Flovin Michaelsen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include "concurrent_sorted_list.h"
+
+namespace gdul
+{
+namespace csldetail
+{
+// Lets any number of threads in at once, spread over padded counters, and
+// holds them off while closed. Closing waits for those inside to leave
+template <std::size_t Stripes, std::size_t CacheLineSize>
+class shard_gate
+{
+public:
+	shard_gate();
+
+	// Returns the stripe to leave through
+	const std::size_t enter();
+	void leave(std::size_t stripe);
+
+	// Fails if the gate is closed already
+	const bool try_close();
+	void open();
+
+private:
+	struct stripe
+	{
+		std::atomic<uint32_t> myEntered;
+		CSL_PADD(CacheLineSize - (sizeof(std::atomic<uint32_t>) % CacheLineSize));
+	};
+
+	CSL_PADD(CacheLineSize);
+	std::atomic<bool> myClosed;
+	CSL_PADD(CacheLineSize - (sizeof(std::atomic<bool>) % CacheLineSize));
+
+	stripe myStripes[Stripes];
+};
+template <std::size_t Stripes, std::size_t CacheLineSize>
+inline shard_gate<Stripes, CacheLineSize>::shard_gate()
+	: myClosed(false)
+{
+	for (stripe& s : myStripes) {
+		s.myEntered.store(0, std::memory_order_relaxed);
+	}
+}
+template <std::size_t Stripes, std::size_t CacheLineSize>
+inline const std::size_t shard_gate<Stripes, CacheLineSize>::enter()
+{
+	const std::size_t index(thread_slot() % Stripes);
+
+	for (;;) {
+		while (myClosed.load(std::memory_order_acquire)) {
+			std::this_thread::yield();
+		}
+
+		// Pairs with the closing thread storing myClosed before reading the stripes
+		myStripes[index].myEntered.fetch_add(1, std::memory_order_seq_cst);
+
+		if (!myClosed.load(std::memory_order_seq_cst)) {
+			return index;
+		}
+
+		myStripes[index].myEntered.fetch_sub(1, std::memory_order_release);
+	}
+}
+template <std::size_t Stripes, std::size_t CacheLineSize>
+inline void shard_gate<Stripes, CacheLineSize>::leave(std::size_t stripe)
+{
+	myStripes[stripe].myEntered.fetch_sub(1, std::memory_order_release);
+}
+template <std::size_t Stripes, std::size_t CacheLineSize>
+inline const bool shard_gate<Stripes, CacheLineSize>::try_close()
+{
+	if (myClosed.load(std::memory_order_relaxed) || myClosed.exchange(true, std::memory_order_seq_cst)) {
+		return false;
+	}
+
+	for (stripe& s : myStripes) {
+		while (s.myEntered.load(std::memory_order_seq_cst)) {
+			std::this_thread::yield();
+		}
+	}
+
+	return true;
+}
+template <std::size_t Stripes, std::size_t CacheLineSize>
+inline void shard_gate<Stripes, CacheLineSize>::open()
+{
+	myClosed.store(false, std::memory_order_release);
+}
+}
+}
@@ -0,0 +1,536 @@
+// Copyright(c) 2019 Flovin Michaelsen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include "concurrent_sorted_list.h"
+#include "tournament_tree.h"
+
+namespace gdul
+{
+namespace csldetail
+{
+template <class KeyType, class ValueType, std::size_t CacheLineSize>
+class producer_fifo;
+}
+
+// A priority queue for producers that each push keys in ascending order, such
+// as timestamps. Every producer appends to a buffer of its own, found through
+// a small thread local cache, mostly without any search. Consumers 
+// take turns popping the lowest head across the buffers, kept in a tournament
+// tree over at most Producers producers. Pushes are constant time and touch 
+// no shared lines, unless the buffer was empty. Pops are logarithmic in the 
+// number of producers
+template <class KeyType, class ValueType, class Comparator = csldetail::tiny_less, std::size_t Producers = 64>
+class tournament_queue
+{
+public:
+	typedef std::size_t size_type;
+	typedef KeyType key_type;
+	typedef ValueType value_type;
+	typedef Comparator comparator_type;
+
+	tournament_queue();
+	~tournament_queue();
+
+	// Keys pushed by one thread must not decrease. At most Producers threads
+	// may push over the lifetime of the queue, pushing from any further 
+	// thread throws std::length_error
+	void push(const std::pair<key_type, value_type>& in);
+	void push(std::pair<key_type, value_type>&& in);
+
+	const bool try_pop(value_type& out);
+	const bool try_pop(std::pair<key_type, value_type>& out);
+
+	// Top key hint
+	const bool try_peek_top_key(key_type& out);
+
+	// Summed over the producers, approximate while in use
+	const size_type size() const;
+
+	void unsafe_clear();
+
+private:
+	static constexpr std::size_t Cache_Line_Size = CSL_CACHE_LINE_SIZE;
+
+	typedef csldetail::producer_fifo<key_type, value_type, Cache_Line_Size> fifo_type;
+
+	fifo_type& this_producer();
+
+	void lock_consumers();
+	void unlock_consumers();
+
+	// Rereads the heads of buffers that producers found empty on push. 
+	// Called holding the consumer lock
+	void refresh();
+
+	// Replays the head of index into the tree
+	void reread(std::size_t index);
+
+	// Registers a buffer for this thread, or throws if out of slots
+	fifo_type& add_producer();
+
+	// Thread local, mapped to by object id. Ids are never reused, so entries
+	// of destroyed queues are never matched, only overwritten
+	struct producer_slot
+	{
+		size_type myObjectId;
+		fifo_type* myProducer;
+	};
+	static constexpr std::size_t Cached_Producers = 8;
+
+	static std::atomic<size_type> ourObjectIterator;
+	static std::atomic<std::uint64_t> ourThreadIterator;
+	static thread_local producer_slot ourProducers[Cached_Producers];
+	static thread_local const std::uint64_t ourThreadId;
+
+	const size_type myObjectId;
+
+	// Pushed to by producers finding their buffer empty
+	std::atomic<fifo_type*> myEmptiedList;
+	std::atomic<std::size_t> myProducerCount;
+	CSL_PADD(Cache_Line_Size - ((sizeof(std::atomic<fifo_type*>) + sizeof(std::atomic<std::size_t>)) % Cache_Line_Size));
+
+	std::atomic<fifo_type*> myProducers[Producers];
+
+	// Touched by the consumer holding myConsuming only
+	std::atomic<bool> myConsuming;
+	csldetail::tournament_tree<key_type, comparator_type> myTree;
+};
+
+template <class KeyType, class ValueType, class Comparator, std::size_t Producers>
+std::atomic<typename tournament_queue<KeyType, ValueType, Comparator, Producers>::size_type> tournament_queue<KeyType, ValueType, Comparator, Producers>::ourObjectIterator(1);
+template <class KeyType, class ValueType, class Comparator, std::size_t Producers>
+std::atomic<std::uint64_t> tournament_queue<KeyType, ValueType, Comparator, Producers>::ourThreadIterator(1);
+template <class KeyType, class ValueType, class Comparator, std::size_t Producers>
+thread_local typename tournament_queue<KeyType, ValueType, Comparator, Producers>::producer_slot tournament_queue<KeyType, ValueType, Comparator, Producers>::ourProducers[Cached_Producers] = {};
+template <class KeyType, class ValueType, class Comparator, std::size_t Producers>
+thread_local const std::uint64_t tournament_queue<KeyType, ValueType, Comparator, Producers>::ourThreadId(ourThreadIterator++);
+
+namespace csldetail
+{
+// Entries of one producer in push order. Pushed to by its producer only, and 
+// popped from by one consumer at a time. Blocks grow in size, each one being 
+// left behind once full
+template <class KeyType, class ValueType, std::size_t CacheLineSize>
+class producer_fifo
+{
+public:
+	typedef std::pair<KeyType, ValueType> entry_type;
+
+	producer_fifo(std::size_t index, std::uint64_t owner);
+	~producer_fifo();
+
+	// Returns true if the fifo was seen empty, in which case the consumers 
+	// must be told
+	const bool push(entry_type&& in);
+
+	const bool try_peek_key(KeyType& out);
+	void pop(entry_type& out);
+
+	const std::size_t size() const;
+	const std::size_t index() const;
+	const std::uint64_t owner() const;
+
+	void unsafe_clear();
+
+	// Set by the producer telling the consumers of an empty fifo having been 
+	// pushed to, cleared by the consumer taking note
+	std::atomic<bool> myEmptied;
+	std::atomic<producer_fifo*> myNextEmptied;
+
+private:
+	static constexpr std::size_t Initial_Block_Capacity = 64;
+	static constexpr std::size_t Max_Block_Capacity = 64 * 1024;
+
+	struct block
+	{
+		block(std::size_t capacity);
+		~block();
+
+		entry_type* const at(std::size_t slot);
+
+		const std::size_t myCapacity;
+		std::atomic<std::size_t> myWritten;
+		std::size_t myRead;
+		std::atomic<block*> myNext;
+		std::unique_ptr<typename std::aligned_storage<sizeof(entry_type), alignof(entry_type)>::type[]> myEntries;
+	};
+
+	// Whether there is an entry to pop, moving the consumer past used up blocks
+	const bool consumable();
+
+	const std::size_t myIndex;
+	const std::uint64_t myOwner;
+
+	CSL_PADD(CacheLineSize);
+	block* myTail;
+	std::atomic<std::size_t> myPushed;
+	CSL_PADD(CacheLineSize - ((sizeof(block*) + sizeof(std::atomic<std::size_t>)) % CacheLineSize));
+	block* myHead;
+	std::atomic<std::size_t> myPopped;
+	CSL_PADD(CacheLineSize - ((sizeof(block*) + sizeof(std::atomic<std::size_t>)) % CacheLineSize));
+};
+}
+
+template <class KeyType, class ValueType, class Comparator, std::size_t Producers>
+inline tournament_queue<KeyType, ValueType, Comparator, Producers>::tournament_queue()
+	: myObjectId(ourObjectIterator++)
+	, myEmptiedList(nullptr)
+	, myProducerCount(0)
+	, myConsuming(false)
+{
+	for (std::atomic<fifo_type*>& producer : myProducers) {
+		producer.store(nullptr, std::memory_order_relaxed);
+	}
+	while (myTree.leaves() < Producers) {
+		myTree.grow();
+	}
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t Producers>
+inline tournament_queue<KeyType, ValueType, Comparator, Producers>::~tournament_queue()
+{
+	for (std::atomic<fifo_type*>& producer : myProducers) {
+		delete producer.load(std::memory_order_relaxed);
+	}
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t Producers>
+inline void tournament_queue<KeyType, ValueType, Comparator, Producers>::push(const std::pair<key_type, value_type>& in)
+{
+	push(std::pair<key_type, value_type>(in));
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t Producers>
+inline void tournament_queue<KeyType, ValueType, Comparator, Producers>::push(std::pair<key_type, value_type>&& in)
+{
+	fifo_type& producer(this_producer());
+
+	if (!producer.push(std::move(in))) {
+		return;
+	}
+
+	if (producer.myEmptied.exchange(true, std::memory_order_acq_rel)) {
+		return;
+	}
+
+	fifo_type* expected(myEmptiedList.load(std::memory_order_relaxed));
+	do {
+		producer.myNextEmptied.store(expected, std::memory_order_relaxed);
+	} while (!myEmptiedList.compare_exchange_weak(expected, &producer, std::memory_order_release, std::memory_order_relaxed));
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t Producers>
+inline const bool tournament_queue<KeyType, ValueType, Comparator, Producers>::try_pop(value_type & out)
+{
+	std::pair<key_type, value_type> pair;
+	if (!try_pop(pair)) {
+		return false;
+	}
+	out = std::move(pair.second);
+	return true;
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t Producers>
+inline const bool tournament_queue<KeyType, ValueType, Comparator, Producers>::try_pop(std::pair<key_type, value_type>& out)
+{
+	lock_consumers();
+
+	refresh();
+
+	const std::size_t winner(myTree.winner());
+
+	if (!myTree.has_key(winner)) {
+		unlock_consumers();
+		return false;
+	}
+
+	myProducers[winner].load(std::memory_order_acquire)->pop(out);
+	reread(winner);
+
+	unlock_consumers();
+
+	return true;
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t Producers>
+inline const bool tournament_queue<KeyType, ValueType, Comparator, Producers>::try_peek_top_key(key_type & out)
+{
+	lock_consumers();
+
+	refresh();
+
+	const std::size_t winner(myTree.winner());
+	const bool result(myTree.has_key(winner));
+
+	if (result) {
+		out = myTree.key(winner);
+	}
+
+	unlock_consumers();
+
+	return result;
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t Producers>
+inline const typename tournament_queue<KeyType, ValueType, Comparator, Producers>::size_type tournament_queue<KeyType, ValueType, Comparator, Producers>::size() const
+{
+	size_type sum(0);
+	for (const std::atomic<fifo_type*>& producer : myProducers) {
+		const fifo_type* const fifo(producer.load(std::memory_order_acquire));
+		if (fifo) {
+			sum += fifo->size();
+		}
+	}
+	return sum;
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t Producers>
+inline void tournament_queue<KeyType, ValueType, Comparator, Producers>::unsafe_clear()
+{
+	for (std::size_t i = 0; i < Producers; ++i) {
+		fifo_type* const fifo(myProducers[i].load(std::memory_order_relaxed));
+		if (fifo) {
+			fifo->unsafe_clear();
+			fifo->myEmptied.store(false, std::memory_order_relaxed);
+		}
+		if (myTree.has_key(i)) {
+			myTree.clear(i);
+		}
+	}
+	myEmptiedList.store(nullptr, std::memory_order_relaxed);
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t Producers>
+inline typename tournament_queue<KeyType, ValueType, Comparator, Producers>::fifo_type & tournament_queue<KeyType, ValueType, Comparator, Producers>::this_producer()
+{
+	producer_slot& slot(ourProducers[myObjectId % Cached_Producers]);
+
+	if (slot.myObjectId == myObjectId) {
+		return *slot.myProducer;
+	}
+
+	// Evicted by another queue, or not yet pushed to from this thread
+	fifo_type* producer(nullptr);
+
+	const std::size_t count((std::min)(myProducerCount.load(std::memory_order_acquire), Producers));
+	for (std::size_t i = 0; i < count; ++i) {
+		fifo_type* const fifo(myProducers[i].load(std::memory_order_acquire));
+		if (fifo && fifo->owner() == ourThreadId) {
+			producer = fifo;
+			break;
+		}
+	}
+
+	if (!producer) {
+		producer = &add_producer();
+	}
+
+	slot.myObjectId = myObjectId;
+	slot.myProducer = producer;
+
+	return *producer;
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t Producers>
+inline typename tournament_queue<KeyType, ValueType, Comparator, Producers>::fifo_type & tournament_queue<KeyType, ValueType, Comparator, Producers>::add_producer()
+{
+	std::size_t index(myProducerCount.load(std::memory_order_relaxed));
+	do {
+		if (!(index < Producers)) {
+			throw std::length_error("Max producers exceeded");
+		}
+	} while (!myProducerCount.compare_exchange_weak(index, index + 1, std::memory_order_relaxed));
+
+	fifo_type* const producer(new fifo_type(index, ourThreadId));
+	myProducers[index].store(producer, std::memory_order_release);
+
+	return *producer;
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t Producers>
+inline void tournament_queue<KeyType, ValueType, Comparator, Producers>::lock_consumers()
+{
+	csl_exponential_backoff<> backoff;
+	while (myConsuming.exchange(true, std::memory_order_acquire)) {
+		while (myConsuming.load(std::memory_order_relaxed)) {
+			backoff();
+		}
+	}
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t Producers>
+inline void tournament_queue<KeyType, ValueType, Comparator, Producers>::unlock_consumers()
+{
+	myConsuming.store(false, std::memory_order_release);
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t Producers>
+inline void tournament_queue<KeyType, ValueType, Comparator, Producers>::refresh()
+{
+	if (!myEmptiedList.load(std::memory_order_relaxed)) {
+		return;
+	}
+
+	for (fifo_type* fifo(myEmptiedList.exchange(nullptr, std::memory_order_acquire)); fifo;) {
+		fifo_type* const next(fifo->myNextEmptied.load(std::memory_order_relaxed));
+
+		// Pushes from here on tell anew
+		fifo->myEmptied.store(false, std::memory_order_seq_cst);
+		reread(fifo->index());
+
+		fifo = next;
+	}
+}
+template <class KeyType, class ValueType, class Comparator, std::size_t Producers>
+inline void tournament_queue<KeyType, ValueType, Comparator, Producers>::reread(std::size_t index)
+{
+	key_type key = key_type();
+	if (myProducers[index].load(std::memory_order_acquire)->try_peek_key(key)) {
+		myTree.set(index, key);
+	}
+	else if (myTree.has_key(index)) {
+		myTree.clear(index);
+	}
+}
+
+namespace csldetail
+{
+template <class KeyType, class ValueType, std::size_t CacheLineSize>
+inline producer_fifo<KeyType, ValueType, CacheLineSize>::producer_fifo(std::size_t index, std::uint64_t owner)
+	: myEmptied(false)
+	, myNextEmptied(nullptr)
+	, myIndex(index)
+	, myOwner(owner)
+	, myTail(new block(Initial_Block_Capacity))
+	, myPushed(0)
+	, myHead(myTail)
+	, myPopped(0)
+{
+}
+template <class KeyType, class ValueType, std::size_t CacheLineSize>
+inline producer_fifo<KeyType, ValueType, CacheLineSize>::~producer_fifo()
+{
+	unsafe_clear();
+	delete myHead;
+}
+template <class KeyType, class ValueType, std::size_t CacheLineSize>
+inline const bool producer_fifo<KeyType, ValueType, CacheLineSize>::push(entry_type && in)
+{
+	std::size_t slot(myTail->myWritten.load(std::memory_order_relaxed));
+
+	if (slot == myTail->myCapacity) {
+		block* const next(new block((std::min)(myTail->myCapacity * 2, Max_Block_Capacity)));
+		myTail->myNext.store(next, std::memory_order_release);
+		myTail = next;
+		slot = 0;
+	}
+
+	new (myTail->at(slot)) entry_type(std::move(in));
+	myTail->myWritten.store(slot + 1, std::memory_order_release);
+
+	// Pairs with the consumer storing myPopped, then loading myPushed. One of
+	// the two is sure to see the other, so that no push goes unnoticed
+	const std::size_t pushed(myPushed.fetch_add(1, std::memory_order_seq_cst));
+
+	return myPopped.load(std::memory_order_seq_cst) == pushed;
+}
+template <class KeyType, class ValueType, std::size_t CacheLineSize>
+inline const bool producer_fifo<KeyType, ValueType, CacheLineSize>::try_peek_key(KeyType & out)
+{
+	if (!consumable()) {
+		return false;
+	}
+
+	out = myHead->at(myHead->myRead)->first;
+
+	return true;
+}
+template <class KeyType, class ValueType, std::size_t CacheLineSize>
+inline void producer_fifo<KeyType, ValueType, CacheLineSize>::pop(entry_type & out)
+{
+	consumable();
+
+	entry_type* const entry(myHead->at(myHead->myRead++));
+	out = std::move(*entry);
+	entry->~entry_type();
+
+	myPopped.store(myPopped.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst);
+}
+template <class KeyType, class ValueType, std::size_t CacheLineSize>
+inline const std::size_t producer_fifo<KeyType, ValueType, CacheLineSize>::size() const
+{
+	const std::size_t popped(myPopped.load(std::memory_order_relaxed));
+	const std::size_t pushed(myPushed.load(std::memory_order_relaxed));
+
+	return popped < pushed ? pushed - popped : 0;
+}
+template <class KeyType, class ValueType, std::size_t CacheLineSize>
+inline const std::size_t producer_fifo<KeyType, ValueType, CacheLineSize>::index() const
+{
+	return myIndex;
+}
+template <class KeyType, class ValueType, std::size_t CacheLineSize>
+inline const std::uint64_t producer_fifo<KeyType, ValueType, CacheLineSize>::owner() const
+{
+	return myOwner;
+}
+template <class KeyType, class ValueType, std::size_t CacheLineSize>
+inline void producer_fifo<KeyType, ValueType, CacheLineSize>::unsafe_clear()
+{
+	while (consumable()) {
+		myHead->at(myHead->myRead++)->~entry_type();
+		myPopped.store(myPopped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+}
+template <class KeyType, class ValueType, std::size_t CacheLineSize>
+inline const bool producer_fifo<KeyType, ValueType, CacheLineSize>::consumable()
+{
+	// Pairs with the producer adding to myPushed, then loading myPopped. 
+	// The entry is visible once its count is
+	if (myPushed.load(std::memory_order_seq_cst) == myPopped.load(std::memory_order_relaxed)) {
+		return false;
+	}
+
+	// The producer moves on only once a block is full
+	while (!(myHead->myRead < myHead->myWritten.load(std::memory_order_acquire))) {
+		block* const next(myHead->myNext.load(std::memory_order_acquire));
+		myHead->myNext.store(nullptr, std::memory_order_relaxed);
+
+		delete myHead;
+		myHead = next;
+	}
+
+	return true;
+}
+template <class KeyType, class ValueType, std::size_t CacheLineSize>
+inline producer_fifo<KeyType, ValueType, CacheLineSize>::block::block(std::size_t capacity)
+	: myCapacity(capacity)
+	, myWritten(0)
+	, myRead(0)
+	, myNext(nullptr)
+	, myEntries(new typename std::aligned_storage<sizeof(entry_type), alignof(entry_type)>::type[capacity])
+{
+}
+template <class KeyType, class ValueType, std::size_t CacheLineSize>
+inline producer_fifo<KeyType, ValueType, CacheLineSize>::block::~block()
+{
+	delete myNext.load(std::memory_order_relaxed);
+}
+template <class KeyType, class ValueType, std::size_t CacheLineSize>
+inline typename producer_fifo<KeyType, ValueType, CacheLineSize>::entry_type * const producer_fifo<KeyType, ValueType, CacheLineSize>::block::at(std::size_t slot)
+{
+	return reinterpret_cast<entry_type*>(&myEntries[slot]);
+}
+}
+}
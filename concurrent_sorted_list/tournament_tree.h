@@ -0,0 +1,156 @@
+// Copyright(c) 2019 Flovin Michaelsen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <vector>
+
+namespace gdul
+{
+namespace csldetail
+{
+// Keys in leaves, with each inner node holding the winning leaf of its 
+// subtree. Any leaf may change, replaying only its own path. Empty leaves 
+// lose to all others
+template <class KeyType, class Comparator>
+class tournament_tree
+{
+public:
+	tournament_tree();
+
+	const std::size_t leaves() const;
+
+	// Doubles the number of leaves. Existing leaves keep their index
+	void grow();
+
+	void set(std::size_t index, const KeyType& key);
+	void clear(std::size_t index);
+
+	// The leaf with the lowest key, should it have one
+	const std::size_t winner() const;
+
+	const bool has_key(std::size_t index) const;
+	const KeyType& key(std::size_t index) const;
+
+private:
+	struct leaf
+	{
+		KeyType myKey;
+		bool myHasKey;
+	};
+
+	void replay(std::size_t index);
+	void play(std::size_t node);
+
+	const bool beats(std::size_t a, std::size_t b) const;
+	const std::size_t winner_of(std::size_t node) const;
+
+	// myWinners[node] holds the winning leaf below node, with the leaves 
+	// themselves following the inner nodes. Node 1 is the root
+	std::vector<leaf> myLeaves;
+	std::vector<std::size_t> myWinners;
+
+	Comparator myComparator;
+};
+
+template <class KeyType, class Comparator>
+inline tournament_tree<KeyType, Comparator>::tournament_tree()
+	: myLeaves(1, leaf{ KeyType(), false })
+	, myWinners(1, 0)
+{
+}
+template <class KeyType, class Comparator>
+inline const std::size_t tournament_tree<KeyType, Comparator>::leaves() const
+{
+	return myLeaves.size();
+}
+template <class KeyType, class Comparator>
+inline void tournament_tree<KeyType, Comparator>::grow()
+{
+	const std::size_t leaves(myLeaves.size() * 2);
+
+	myLeaves.resize(leaves, leaf{ KeyType(), false });
+	myWinners.assign(leaves, 0);
+
+	for (std::size_t node = leaves - 1; node; --node) {
+		play(node);
+	}
+}
+template <class KeyType, class Comparator>
+inline void tournament_tree<KeyType, Comparator>::set(std::size_t index, const KeyType & key)
+{
+	myLeaves[index].myKey = key;
+	myLeaves[index].myHasKey = true;
+
+	replay(index);
+}
+template <class KeyType, class Comparator>
+inline void tournament_tree<KeyType, Comparator>::clear(std::size_t index)
+{
+	myLeaves[index].myHasKey = false;
+
+	replay(index);
+}
+template <class KeyType, class Comparator>
+inline const std::size_t tournament_tree<KeyType, Comparator>::winner() const
+{
+	return winner_of(1);
+}
+template <class KeyType, class Comparator>
+inline const bool tournament_tree<KeyType, Comparator>::has_key(std::size_t index) const
+{
+	return myLeaves[index].myHasKey;
+}
+template <class KeyType, class Comparator>
+inline const KeyType & tournament_tree<KeyType, Comparator>::key(std::size_t index) const
+{
+	return myLeaves[index].myKey;
+}
+template <class KeyType, class Comparator>
+inline void tournament_tree<KeyType, Comparator>::replay(std::size_t index)
+{
+	for (std::size_t node((myLeaves.size() + index) / 2); node; node /= 2) {
+		play(node);
+	}
+}
+template <class KeyType, class Comparator>
+inline void tournament_tree<KeyType, Comparator>::play(std::size_t node)
+{
+	const std::size_t left(winner_of(node * 2));
+	const std::size_t right(winner_of(node * 2 + 1));
+
+	myWinners[node] = beats(right, left) ? right : left;
+}
+template <class KeyType, class Comparator>
+inline const bool tournament_tree<KeyType, Comparator>::beats(std::size_t a, std::size_t b) const
+{
+	const leaf& first(myLeaves[a]);
+	const leaf& second(myLeaves[b]);
+
+	return first.myHasKey && (!second.myHasKey || myComparator(first.myKey, second.myKey));
+}
+template <class KeyType, class Comparator>
+inline const std::size_t tournament_tree<KeyType, Comparator>::winner_of(std::size_t node) const
+{
+	// A single leaf is its own root
+	return node < myLeaves.size() ? myWinners[node] : node - myLeaves.size();
+}
+}
+}
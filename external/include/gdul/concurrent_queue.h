@@ -53,6 +53,11 @@
 
 #define CQ_PADDING(bytes) const uint8_t MAKE_UNIQUE_NAME(trash)[bytes] {}
 
+// Granularity of false sharing assumed when padding members apart
+#ifndef CQ_CACHE_LINE_SIZE
+#define CQ_CACHE_LINE_SIZE 64
+#endif
+
 // For anonymous struct
 #pragma warning(push)
 #pragma warning(disable : 4201) 
@@ -635,16 +640,16 @@ private:
 
 	const size_type myCapacity;
 	item_container<T>* const myDataBlock;
-	CQ_PADDING(128 - sizeof(void*));
+	CQ_PADDING(CQ_CACHE_LINE_SIZE * 2 - sizeof(void*));
 	std::atomic<size_type> myReadSlot;
-	CQ_PADDING(64 - sizeof(size_type));
+	CQ_PADDING(CQ_CACHE_LINE_SIZE - sizeof(size_type));
 	std::atomic<size_type> myPreReadIterator;
 
 #ifdef CQ_ENABLE_EXCEPTIONHANDLING
 	std::atomic<uint16_t> myFailiureCount;
 	std::atomic<uint16_t> myFailiureIndex;
 	bool myValidFlag;
-	CQ_PADDING(64 - 5);
+	CQ_PADDING(CQ_CACHE_LINE_SIZE - 5);
 	std::atomic<size_type> myPostReadIterator;
 #endif
 };